@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Copyright 2016 LambdaStack All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Reports the output throughput, in MB/s, of the default and the --compact JSON output.
+#
+# Usage: manifest_throughput.sh [<jsonlang binary> [<program>]]
+
+JSONLANG="${1:-$(dirname "$0")/../jsonlang}"
+PROGRAM="${2:-$(dirname "$0")/bench.04.jsonlang}"
+RUNS=3
+
+for MODE in "" "--compact" ; do
+    BEST=""
+    for ((i = 0 ; i < RUNS ; i++)) ; do
+        START=$(date +%s%N)
+        BYTES=$("$JSONLANG" $MODE "$PROGRAM" | wc -c)
+        END=$(date +%s%N)
+        NS=$((END - START))
+        if [ -z "$BEST" ] || [ $NS -lt $BEST ] ; then
+            BEST=$NS
+        fi
+    done
+    awk -v mode="${MODE:-default}" -v bytes=$BYTES -v ns=$BEST 'BEGIN {
+        printf "%-10s %8.1f MB in %6.3f s: %7.1f MB/s\n", mode, bytes / 1e6, ns / 1e9, bytes / 1e6 / (ns / 1e9)
+    }'
+done
@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Copyright 2016 LambdaStack All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Reports the peak resident memory, in MB, of evaluating a program.  Exits with status 1 if it is
+# more than the given limit.
+#
+# Usage: peak_memory.sh [<jsonlang binary> [<program> [<limit MB>]]]
+
+JSONLANG="${1:-$(dirname "$0")/../jsonlang}"
+PROGRAM="${2:-$(dirname "$0")/bench.05.jsonlang}"
+LIMIT="${3:-100}"
+
+python3 - "$JSONLANG" "$PROGRAM" "$LIMIT" <<'PYTHON'
+import resource
+import subprocess
+import sys
+
+jsonlang, program, limit = sys.argv[1], sys.argv[2], int(sys.argv[3])
+subprocess.check_call([jsonlang, program], stdout=subprocess.DEVNULL)
+mb = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss // 1024
+print("%s: %d MB peak resident (limit %d MB)" % (program, mb, limit))
+sys.exit(0 if mb <= limit else 1)
+PYTHON
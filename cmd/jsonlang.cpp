@@ -14,21 +14,33 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <exception>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 extern "C" {
     #include <libjsonlang.h>
 }
 
+#include "file_source.h"
+
 std::string next_arg(unsigned &i, const std::vector<std::string> &args)
 {
     i++;
@@ -81,8 +93,11 @@ void usage(std::ostream &o)
     o << "  -J / --jpath <dir>      Specify an additional library search dir\n";
     o << "  -o / --output-file <file> Write to the output file rather than stdout\n";
     o << "  -m / --multi <dir>      Write multiple files to the directory, list files on stdout\n";
+    o << "  -j / --jobs <n>         With -m, manifest the files in this many processes\n";
     o << "  -y / --yaml-stream      Write output as a YAML stream of JSON documents\n";
     o << "  -S / --string           Expect a string, manifest as plain text\n";
+    o << "  --compact               Write the JSON minified, without whitespace\n";
+    o << "  --output-format <fmt>   Write the output as json (the default), cbor or msgpack\n";
     o << "  -s / --max-stack <n>    Number of allowed stack frames\n";
     o << "  -t / --max-trace <n>    Max length of stack trace before cropping\n";
     o << "  --gc-min-objects <n>    Do not run garbage collector until this many\n";
@@ -159,6 +174,8 @@ struct JsonlangConfig {
     // EVAL flags
     bool evalMulti;
     bool evalStream;
+    bool evalString;
+    bool evalBinary;
     std::string evalMultiOutputDir;
 
     // FMT flags
@@ -169,6 +186,8 @@ struct JsonlangConfig {
       : cmd(EVAL), filenameIsCode(false),
         evalMulti(false),
         evalStream(false),
+        evalString(false),
+        evalBinary(false),
         fmtInPlace(false),
         fmtTest(false)
     { }
@@ -260,6 +279,15 @@ static bool process_args(int argc,
                     return false;
                 }
                 jsonlang_max_stack(vm, l);
+            } else if (arg == "-j" || arg == "--jobs") {
+                long l = strtol_check(next_arg(i, args));
+                if (l < 1) {
+                    std::cerr << "ERROR: Invalid --jobs value: " << l << "\n"
+                              << std::endl;
+                    usage(std::cerr);
+                    return false;
+                }
+                jsonlang_jobs(vm, l);
             } else if (arg == "-J" || arg == "--jpath") {
                 std::string dir = next_arg(i, args);
                 if (dir.length() == 0) {
@@ -366,6 +394,18 @@ static bool process_args(int argc,
                 config->evalStream = true;
             } else if (arg == "-S" || arg == "--string") {
                 jsonlang_string_output(vm, 1);
+                config->evalString = true;
+            } else if (arg == "--compact") {
+                jsonlang_output_compact(vm, 1);
+            } else if (arg == "--output-format") {
+                std::string format = next_arg(i, args);
+                if (!jsonlang_output_format(vm, format.c_str())) {
+                    std::cerr << "ERROR: Invalid --output-format value: " << format << "\n"
+                              << std::endl;
+                    usage(std::cerr);
+                    return false;
+                }
+                config->evalBinary = format != "json";
             } else if (arg.length() > 1 && arg[0] == '-') {
                 std::cerr << "ERROR: Unrecognized argument: " << arg << std::endl;
                 return EXIT_FAILURE;
@@ -464,32 +504,43 @@ static bool process_args(int argc,
         return false;
     }
     config->inputFile = filename;
+
+    if (config->evalStream && config->evalBinary) {
+        std::cerr << "ERROR: -y writes YAML, which cannot hold a binary --output-format\n"
+                  << std::endl;
+        usage(std::cerr);
+        return false;
+    }
+    if (config->evalString && config->evalBinary) {
+        std::cerr << "ERROR: -S writes plain text, which cannot have a binary --output-format\n"
+                  << std::endl;
+        usage(std::cerr);
+        return false;
+    }
     return true;
 }
 
-/** Reads Jsonlang code from the input file or stdin into the input buffer. */
-static bool read_input(JsonlangConfig* config, std::string* input) {
+/** Reads Jsonlang code from the input file or stdin.  Files are mapped rather than copied. */
+static bool read_input(JsonlangConfig* config, std::shared_ptr<const FileSource> *input) {
     if (config->filenameIsCode) {
-        *input = config->inputFile;
+        *input = FileSource::fromString(config->inputFile);
         config->inputFile = "<cmdline>";
     } else {
+        std::string err_msg;
         if (config->inputFile == "-") {
             config->inputFile = "<stdin>";
-            input->assign(std::istreambuf_iterator<char>(std::cin),
-                          std::istreambuf_iterator<char>());
-        } else {
-            std::ifstream f;
-            f.open(config->inputFile.c_str());
-            if (!f.good()) {
-                std::string msg = "Opening input file: " + config->inputFile;
-                perror(msg.c_str());
+            *input = FileSource::read(STDIN_FILENO, err_msg);
+            if (*input == nullptr) {
+                std::cerr << "Reading input file: " << config->inputFile << ": " << err_msg
+                          << std::endl;
                 return false;
             }
-            input->assign(std::istreambuf_iterator<char>(f),
-                          std::istreambuf_iterator<char>());
-            if (!f.good()) {
-                std::string msg = "Reading input file: " + config->inputFile;
-                perror(msg.c_str());
+        } else {
+            bool found;
+            *input = FileSource::open(config->inputFile, found, err_msg);
+            if (*input == nullptr) {
+                std::cerr << (found ? "Reading" : "Opening") << " input file: "
+                          << config->inputFile << ": " << err_msg << std::endl;
                 return false;
             }
         }
@@ -497,84 +548,345 @@ static bool read_input(JsonlangConfig* config, std::string* input) {
     return true;
 }
 
-/** Writes output files for multiple file output */
-static bool write_multi_output_files(JsonlangVm* vm, char* output,
-                                     const std::string& output_dir)
+/** Name of the file, in the output directory of multi mode, recording what was last written. */
+static const char *MULTI_SIDECAR = ".jsonlang-multi";
+
+/** What the sidecar records about an output file, so it can be compared without reading it. */
+struct MultiFileState {
+    unsigned long long hash;
+    unsigned long long size;
+    long long mtime;  // Nanoseconds, so edits within the same second are still noticed.
+    /** Unlike mtime, this cannot be set back, e.g. by restoring a file with cp -p. */
+    long long ctime;
+};
+
+static long long stat_mtime(const struct stat &st)
+{
+#ifdef __APPLE__
+    return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+static long long stat_ctime(const struct stat &st)
 {
-    // If multiple file output is used, then iterate over each string from
-    // the sequence of strings returned by jsonlang_evaluate_snippet_multi,
-    // construct pairs of filename and content, and write each output file.
-    std::map<std::string, std::string> r;
-    for (const char *c=output ; *c!='\0' ; ) {
-        const char *filename = c;
-        const char *c2 = c;
-        while (*c2 != '\0') ++c2;
-        ++c2;
-        const char *json = c2;
-        while (*c2 != '\0') ++c2;
-        ++c2;
-        c = c2;
-        r[filename] = json;
+#ifdef __APPLE__
+    return st.st_ctimespec.tv_sec * 1000000000LL + st.st_ctimespec.tv_nsec;
+#else
+    return st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+#endif
+}
+
+/** 64 bit FNV-1a, which is plenty to spot a changed file. */
+static unsigned long long content_hash(const std::string &s)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
     }
-    jsonlang_realloc(vm, output, 0);
-    for (const auto &pair : r) {
-        const std::string &new_content = pair.second;
-        const std::string &filename = output_dir + pair.first;
-        std::cout << filename << std::endl;
-        {
-            std::ifstream exists(filename.c_str());
-            if (exists.good()) {
-                std::string existing_content;
-                existing_content.assign(std::istreambuf_iterator<char>(exists),
-                                        std::istreambuf_iterator<char>());
-                if (existing_content == new_content) {
-                    // Do not bump the timestamp on the file if its content is
-                    // the same. This may trigger other tools (e.g. make) to do
-                    // unnecessary work.
-                    continue;
-                }
-            }
-        }
-        std::ofstream f;
-        f.open(filename.c_str());
-        if (!f.good()) {
-            std::string msg = "Opening output file: " + filename;
-            perror(msg.c_str());
-            jsonlang_destroy(vm);
+    return h;
+}
+
+/** Reads the sidecar from a previous run, if there is one.
+ *
+ * As with git's "racily clean" index entries, a file whose timestamps are not older than the
+ * sidecar may have been changed again within the same clock tick, without them changing.  Such
+ * files are left out, so that their content is compared.
+ */
+static std::map<std::string, MultiFileState> read_multi_sidecar(const std::string &path)
+{
+    std::map<std::string, MultiFileState> r;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return r;
+    const long long written = stat_mtime(st);
+    std::ifstream f(path.c_str());
+    MultiFileState state;
+    std::string name;
+    while (f >> std::hex >> state.hash >> std::dec >> state.size >> state.mtime
+             >> state.ctime) {
+        f.get();  // The space before the name.
+        if (!std::getline(f, name)) break;
+        if (state.mtime < written && state.ctime < written) r[name] = state;
+    }
+    return r;
+}
+
+/** Whether the file at path already holds content, judging by the sidecar if possible. */
+static bool multi_file_unchanged(const std::string &path, const std::string &content,
+                                 unsigned long long hash, const MultiFileState *recorded,
+                                 MultiFileState &state)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    state.size = st.st_size;
+    state.mtime = stat_mtime(st);
+    state.ctime = stat_ctime(st);
+    if (state.size != content.length()) return false;
+    if (recorded != nullptr && recorded->size == state.size && recorded->mtime == state.mtime
+        && recorded->ctime == state.ctime)
+        return recorded->hash == hash;
+    // Not written by us, or changed since, so compare the content.
+    std::ifstream exists(path.c_str());
+    if (!exists.good()) return false;
+    std::string existing_content;
+    existing_content.assign(std::istreambuf_iterator<char>(exists),
+                            std::istreambuf_iterator<char>());
+    return existing_content == content;
+}
+
+/** The message for errno value err.  Unlike strerror, safe to call from several threads. */
+static std::string error_string(int err)
+{
+    char buf[256];
+    // strerror_r is the GNU or the POSIX one, depending on the platform.
+    struct Result {
+        const char *buf;
+        std::string operator()(int r) const { return r == 0 ? buf : "Unknown error"; }
+        std::string operator()(const char *r) const { return r; }
+    } result = {buf};
+    return result(strerror_r(err, buf, sizeof buf));
+}
+
+/** Writes all of content to fd, returning false (with errno set) on failure. */
+static bool write_all(int fd, const std::string &content)
+{
+    const char *p = content.data();
+    size_t left = content.length();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
             return false;
         }
-        f << new_content;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+/** Writes content to path atomically, by writing a temporary file and renaming it.
+ *
+ * The file keeps its mode.  If path is a symlink, the file it points to is written in place
+ * instead, so that the link is kept.  This is called from several threads at once.
+ *
+ * \param new_mode The mode of the file if it does not exist yet.
+ * \returns The empty string, or an error message.
+ */
+static std::string write_file_atomically(const std::string &path, const std::string &content,
+                                         mode_t new_mode, MultiFileState &state)
+{
+    struct stat st;
+    bool exists = lstat(path.c_str(), &st) == 0;
+    if (exists && S_ISLNK(st.st_mode)) {
+        std::ofstream f;
+        f.open(path.c_str(), std::ios::binary);
+        if (!f.good())
+            return "Opening output file: " + path + ": " + error_string(errno);
+        f << content;
         f.close();
-        if (!f.good()) {
-            std::string msg = "Writing to output file: " + filename;
-            perror(msg.c_str());
+        if (!f.good())
+            return "Writing to output file: " + path + ": " + error_string(errno);
+    } else {
+        // mkstemp makes a name that no other output file (or thread) is using.
+        std::string tmp_template = path + ".jsonlang-XXXXXX";
+        std::vector<char> tmp_name(tmp_template.begin(), tmp_template.end());
+        tmp_name.push_back('\0');
+        int fd = mkstemp(tmp_name.data());
+        const std::string tmp = tmp_name.data();
+        if (fd < 0)
+            return "Opening output file: " + tmp + ": " + error_string(errno);
+        bool ok = fchmod(fd, exists ? st.st_mode & 07777 : new_mode) == 0
+                  && write_all(fd, content);
+        int err = errno;
+        if (close(fd) != 0 && ok) {
+            ok = false;
+            err = errno;
+        }
+        if (!ok) {
+            std::remove(tmp.c_str());
+            return "Writing to output file: " + tmp + ": " + error_string(err);
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::string msg = "Renaming output file: " + tmp + ": " + error_string(errno);
+            std::remove(tmp.c_str());
+            return msg;
+        }
+    }
+    if (stat(path.c_str(), &st) != 0)
+        return "Writing to output file: " + path + ": " + error_string(errno);
+    state.size = st.st_size;
+    state.mtime = stat_mtime(st);
+    state.ctime = stat_ctime(st);
+    return "";
+}
+
+/** Writes output files for multiple file output.
+ *
+ * Files whose content has not changed are left alone, so as not to bump their timestamps.  This
+ * may otherwise trigger other tools (e.g. make) to do unnecessary work.  The size, timestamps and
+ * hash of each file are recorded in a sidecar in the output directory, so the next run need not
+ * read the files again.  The files are written from a pool of threads.
+ */
+static bool write_multi_output_files(
+    JsonlangVm* vm, const std::vector<std::pair<std::string, std::string>> &files,
+    const std::string& output_dir)
+{
+    for (const auto &file : files) {
+        if (file.first == MULTI_SIDECAR) {
+            std::cerr << "ERROR: " << MULTI_SIDECAR << " cannot be an output file, as -m uses it "
+                      << "to record the files it has written." << std::endl;
             jsonlang_destroy(vm);
             return false;
         }
     }
+    for (const auto &file : files) {
+        std::cout << output_dir + file.first << std::endl;
+    }
+    const std::string sidecar_path = output_dir + MULTI_SIDECAR;
+    // New files get the usual mode, 0666 less the umask, which cannot be read without setting.
+    mode_t mask = umask(0);
+    umask(mask);
+    const mode_t new_mode = 0666 & ~mask;
+    const std::map<std::string, MultiFileState> recorded = read_multi_sidecar(sidecar_path);
+
+    std::vector<MultiFileState> states(files.size());
+    std::vector<std::string> errors(files.size());
+    std::vector<char> changed(files.size(), false);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++ ; i < files.size() ; i = next++) {
+            const std::string &path = output_dir + files[i].first;
+            const std::string &content = files[i].second;
+            states[i].hash = content_hash(content);
+            auto it = recorded.find(files[i].first);
+            if (multi_file_unchanged(path, content, states[i].hash,
+                                     it == recorded.end() ? nullptr : &it->second, states[i]))
+                continue;
+            changed[i] = true;
+            errors[i] = write_file_atomically(path, content, new_mode, states[i]);
+        }
+    };
+    size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                          files.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1 ; i < num_threads ; ++i)
+        threads.emplace_back(work);
+    work();
+    for (auto &thread : threads)
+        thread.join();
+
+    bool ok = true;
+    unsigned long num_changed = 0;
+    std::stringstream sidecar;
+    for (size_t i = 0 ; i < files.size() ; ++i) {
+        if (!errors[i].empty()) {
+            std::cerr << errors[i] << std::endl;
+            ok = false;
+            continue;
+        }
+        if (changed[i]) num_changed++;
+        // Names with a newline in them cannot be recorded, and are just compared next time.
+        if (files[i].first.find('\n') != std::string::npos) continue;
+        sidecar << std::hex << states[i].hash << std::dec << " " << states[i].size << " "
+                << states[i].mtime << " " << states[i].ctime << " " << files[i].first << "\n";
+    }
+    // The sidecar is only an optimization, so failing to write it is not an error.
+    MultiFileState sidecar_state;
+    write_file_atomically(sidecar_path, sidecar.str(), new_mode, sidecar_state);
     std::cout.flush();
+    if (!ok) {
+        jsonlang_destroy(vm);
+        return false;
+    }
+    std::cerr << num_changed << " file(s) changed, " << files.size() - num_changed
+              << " unchanged." << std::endl;
     return true;
 }
 
-/** Writes output files for YAML stream output */
-static bool write_output_stream(JsonlangVm* vm, char* output)
+/** Callback that appends the output to the std::string at ctx. */
+static int string_write(void *ctx, const char *buf, size_t len)
 {
-    // If YAML stream output is used, then iterate over each string from
-    // the sequence of strings returned by jsonlang_evaluate_snippet_stream,
-    // and add the --- and ... as defined by the YAML spec.
-    std::vector<std::string> r;
-    for (const char *c=output ; *c!='\0' ; ) {
-        const char *json = c;
-        while (*c != '\0') ++c;
-        ++c;
-        r.emplace_back(json);
-    }
-    jsonlang_realloc(vm, output, 0);
-    for (const auto &str : r) {
-        std::cout << "---\n";
-        std::cout << str;
+    static_cast<std::string*>(ctx)->append(buf, len);
+    return 0;
+}
+
+/** Callbacks that collect the files of multi mode.  ctx points at the vector of files. */
+static int multi_begin(void *ctx, const char *name)
+{
+    auto *files = static_cast<std::vector<std::pair<std::string, std::string>>*>(ctx);
+    files->emplace_back(name, "");
+    return 0;
+}
+
+static int multi_write(void *ctx, const char *buf, size_t len)
+{
+    auto *files = static_cast<std::vector<std::pair<std::string, std::string>>*>(ctx);
+    files->back().second.append(buf, len);
+    return 0;
+}
+
+/** The state of the YAML stream callbacks. */
+struct StreamState {
+    /** The number of documents written so far. */
+    unsigned long documents;
+    /** The document being manifested. */
+    std::string document;
+    StreamState(void)
+      : documents(0)
+    { }
+};
+
+/** Callbacks that write YAML stream output to stdout as each document is manifested.
+ *
+ * The --- and ... are added as defined by the YAML spec.  Each document is held until it is
+ * complete, so a later error does not leave part of one on stdout for downstream tools to
+ * consume.  ctx points at a StreamState.
+ */
+static int stream_begin(void *ctx, const char *name)
+{
+    (void) name;
+    static_cast<StreamState*>(ctx)->document.clear();
+    return 0;
+}
+
+static int stream_write(void *ctx, const char *buf, size_t len)
+{
+    static_cast<StreamState*>(ctx)->document.append(buf, len);
+    return 0;
+}
+
+static int stream_end(void *ctx, const char *name)
+{
+    (void) name;
+    auto *state = static_cast<StreamState*>(ctx);
+    state->documents++;
+    std::cout << "---\n";
+    std::cout.write(state->document.data(), state->document.length());
+    // Let downstream tools start on each document as soon as it is complete.
+    std::cout.flush();
+    state->document.clear();
+    return std::cout.good() ? 0 : 1;
+}
+
+/** Evaluates the input and writes it as a YAML stream, one document at a time. */
+static bool eval_output_stream(JsonlangVm* vm, const JsonlangConfig &config,
+                               const char *input)
+{
+    int error;
+    StreamState state;
+    char *msg = jsonlang_evaluate_snippet_stream_write(
+        vm, config.inputFile.c_str(), input, stream_begin, stream_write, stream_end,
+        &state, &error);
+    if (error) {
+        std::cout.flush();
+        std::cerr << msg;
+        std::cerr.flush();
+        jsonlang_realloc(vm, msg, 0);
+        return false;
     }
-    if (r.size() > 0)
+    if (state.documents > 0)
         std::cout << "...\n";
     std::cout.flush();
     return true;
@@ -583,21 +895,21 @@ static bool write_output_stream(JsonlangVm* vm, char* output)
 /** Writes the output JSON to the specified output file for single-file
  * output
  */
-static bool write_output_file(const char* output,
+static bool write_output_file(const char* output, size_t len,
                               const std::string &output_file) {
     if (output_file.empty()) {
-        std::cout << output;
+        std::cout.write(output, len);
         std::cout.flush();
         return true;
     }
     std::ofstream f;
-    f.open(output_file.c_str());
+    f.open(output_file.c_str(), std::ios::binary);
     if (!f.good()) {
         std::string msg = "Writing to output file: " + output_file;
         perror(msg.c_str());
         return false;
     }
-    f << output;
+    f.write(output, len);
     f.close();
     if (!f.good()) {
         std::string msg = "Writing to output file: " + output_file;
@@ -617,7 +929,7 @@ int main(int argc, const char **argv)
         }
 
         // Read input files.
-        std::string input;
+        std::shared_ptr<const FileSource> input;
         if (!read_input(&config, &input)) {
             return EXIT_FAILURE;
         }
@@ -627,16 +939,49 @@ int main(int argc, const char **argv)
         char *output;
         switch (config.cmd) {
             case EVAL: {
+                if (config.evalStream) {
+                    bool successful = eval_output_stream(vm, config, input->data());
+                    jsonlang_destroy(vm);
+                    return successful ? EXIT_SUCCESS : EXIT_FAILURE;
+                }
                 if (config.evalMulti) {
-                    output = jsonlang_evaluate_snippet_multi(
-                        vm, config.inputFile.c_str(), input.c_str(), &error);
-                } else if (config.evalStream) {
-                    output = jsonlang_evaluate_snippet_stream(
-                        vm, config.inputFile.c_str(), input.c_str(), &error);
-                } else {
-                    output = jsonlang_evaluate_snippet(
-                        vm, config.inputFile.c_str(), input.c_str(), &error);
+                    // Collect all the files first, so nothing is written if evaluation fails.
+                    std::vector<std::pair<std::string, std::string>> files;
+                    char *err = jsonlang_evaluate_snippet_multi_write(
+                        vm, config.inputFile.c_str(), input->data(), multi_begin, multi_write,
+                        nullptr, &files, &error);
+                    if (error) {
+                        std::cerr << err;
+                        std::cerr.flush();
+                        jsonlang_realloc(vm, err, 0);
+                        jsonlang_destroy(vm);
+                        return EXIT_FAILURE;
+                    }
+                    if (!write_multi_output_files(vm, files, config.evalMultiOutputDir)) {
+                        return EXIT_FAILURE;
+                    }
+                    break;
+                }
+                if (config.evalBinary) {
+                    // Binary output may contain NULs, so is collected through a callback.
+                    std::string binary;
+                    char *err = jsonlang_evaluate_snippet_write(
+                        vm, config.inputFile.c_str(), input->data(), string_write, &binary,
+                        &error);
+                    if (error) {
+                        std::cerr << err;
+                        std::cerr.flush();
+                        jsonlang_realloc(vm, err, 0);
+                        jsonlang_destroy(vm);
+                        return EXIT_FAILURE;
+                    }
+                    bool successful = write_output_file(binary.data(), binary.length(),
+                                                        config.outputFile);
+                    jsonlang_destroy(vm);
+                    return successful ? EXIT_SUCCESS : EXIT_FAILURE;
                 }
+                output = jsonlang_evaluate_snippet(
+                    vm, config.inputFile.c_str(), input->data(), &error);
 
                 if (error) {
                     std::cerr << output;
@@ -647,21 +992,11 @@ int main(int argc, const char **argv)
                 }
 
                 // Write output JSON.
-                if (config.evalMulti) {
-                    if (!write_multi_output_files(vm, output, config.evalMultiOutputDir)) {
-                        return EXIT_FAILURE;
-                    }
-                } else if (config.evalStream) {
-                    if (!write_output_stream(vm, output)) {
-                        return EXIT_FAILURE;
-                    }
-                } else {
-                    bool successful = write_output_file(output, config.outputFile);
-                    jsonlang_realloc(vm, output, 0);
-                    if (!successful) {
-                        jsonlang_destroy(vm);
-                        return EXIT_FAILURE;
-                    }
+                bool successful = write_output_file(output, strlen(output), config.outputFile);
+                jsonlang_realloc(vm, output, 0);
+                if (!successful) {
+                    jsonlang_destroy(vm);
+                    return EXIT_FAILURE;
                 }
             }
             break;
@@ -682,7 +1017,7 @@ int main(int argc, const char **argv)
                     output_file = config.inputFile;
                 }
 
-                output = jsonlang_fmt_snippet(vm, config.inputFile.c_str(), input.c_str(), &error);
+                output = jsonlang_fmt_snippet(vm, config.inputFile.c_str(), input->data(), &error);
 
                 if (error) {
                     std::cerr << output;
@@ -694,14 +1029,15 @@ int main(int argc, const char **argv)
 
                 if (config.fmtTest) {
                     // Check the output matches the input.
-                    bool ok = output == input;
+                    bool ok = std::strlen(output) == input->size()
+                              && std::memcmp(output, input->data(), input->size()) == 0;
                     jsonlang_realloc(vm, output, 0);
                     jsonlang_destroy(vm);
                     return ok ? EXIT_SUCCESS : 2;
 
                 } else {
                     // Write output Jsonlang.
-                    bool successful = write_output_file(output, output_file);
+                    bool successful = write_output_file(output, strlen(output), output_file);
                     jsonlang_realloc(vm, output, 0);
                     if (!successful) {
                         jsonlang_destroy(vm);
@@ -39,6 +39,7 @@ limitations under the License.
 #include <iostream>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "lexer.h"
@@ -772,7 +773,7 @@ struct Var : public AST {
 /** Allocates ASTs on demand, frees them in its destructor.
  */
 class Allocator {
-    std::map<String, const Identifier*> internedIdentifiers;
+    std::unordered_map<String, const Identifier*> internedIdentifiers;
     ASTs allocated;
     public:
     template <class T, class... Args> T* make(Args&&... args)
@@ -795,6 +796,15 @@ class Allocator {
         internedIdentifiers[name] = r;
         return r;
     }
+    /** Returns the interned identifier, or nullptr if there is none, without making one.
+     *
+     * Every field name is interned, so nullptr means no object has a field of that name.
+     */
+    const Identifier *findIdentifier(const String &name) const
+    {
+        auto it = internedIdentifiers.find(name);
+        return it == internedIdentifiers.end() ? nullptr : it->second;
+    }
     ~Allocator()
     {
         for (auto x : allocated) {
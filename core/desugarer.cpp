@@ -31,7 +31,7 @@ struct BuiltinDecl {
     std::vector<String> params;
 };
 
-static unsigned long max_builtin = 25;
+static unsigned long max_builtin = 63;
 BuiltinDecl jsonlang_builtin_decl(unsigned long builtin)
 {
     switch (builtin) {
@@ -61,6 +61,44 @@ BuiltinDecl jsonlang_builtin_decl(unsigned long builtin)
         case 23: return {U"extVar", {U"x"}};
         case 24: return {U"primitiveEquals", {U"a", U"b"}};
         case 25: return {U"native", {U"name"}};
+        case 26: return {U"memoize", {U"func"}};
+        case 27: return {U"memoizeStats", {U"func"}};
+        case 28: return {U"substr", {U"str", U"from", U"len"}};
+        case 29: return {U"startsWith", {U"a", U"b"}};
+        case 30: return {U"endsWith", {U"a", U"b"}};
+        case 31: return {U"stringChars", {U"str"}};
+        case 32: return {U"split", {U"str", U"c"}};
+        case 33: return {U"splitLimit", {U"str", U"c", U"maxsplits"}};
+        case 34: return {U"join", {U"sep", U"arr"}};
+        case 35: return {U"format", {U"str", U"vals"}};
+        case 36: return {U"mod", {U"a", U"b"}};
+        case 37: return {U"sort", {U"arr"}};
+        case 38: return {U"uniq", {U"arr"}};
+        case 39: return {U"set", {U"arr"}};
+        case 40: return {U"setMember", {U"x", U"arr"}};
+        case 41: return {U"setUnion", {U"a", U"b"}};
+        case 42: return {U"setInter", {U"a", U"b"}};
+        case 43: return {U"setDiff", {U"a", U"b"}};
+        case 44: return {U"foldl", {U"func", U"arr", U"init"}};
+        case 45: return {U"foldr", {U"func", U"arr", U"init"}};
+        case 46: return {U"map", {U"func", U"arr"}};
+        case 47: return {U"filterMap", {U"filter_func", U"map_func", U"arr"}};
+        case 48: return {U"flattenArrays", {U"arrs"}};
+        case 49: return {U"escapeStringJson", {U"str_"}};
+        case 50: return {U"manifestJsonEx", {U"value", U"indent"}};
+        case 51: return {U"manifestYamlStream", {U"value"}};
+        case 52: return {U"manifestIni", {U"ini"}};
+        case 53: return {U"manifestPython", {U"o"}};
+        case 54: return {U"manifestPythonVars", {U"conf"}};
+        case 55: return {U"escapeStringBash", {U"str_"}};
+        case 56: return {U"escapeStringDollars", {U"str_"}};
+        case 57: return {U"base64", {U"input"}};
+        case 58: return {U"base64DecodeBytes", {U"str"}};
+        case 59: return {U"base64Decode", {U"str"}};
+        case 60: return {U"mergePatch", {U"target", U"patch"}};
+        case 61: return {U"parseInt", {U"str"}};
+        case 62: return {U"parseOctal", {U"str"}};
+        case 63: return {U"parseHex", {U"str"}};
         default:
         std::cerr << "INTERNAL ERROR: Unrecognized builtin function: " << builtin << std::endl;
         std::abort();
@@ -169,11 +207,6 @@ class Desugarer {
         return stdFunc(loc, U"primitiveEquals", a, b);
     }
 
-    Apply *equals(const LocationRange &loc, AST *a, AST *b)
-    {
-        return stdFunc(loc, U"equals", a, b);
-    }
-
     Error *error(AST *msg)
     {
         return make<Error>(msg->location, EF, msg);
@@ -446,7 +479,7 @@ class Desugarer {
                             make<Conditional>(
                                 ast->location,
                                 EF,
-                                equals(ast->location, type(var(_l)), str(U"array")),
+                                primitiveEquals(ast->location, type(var(_l)), str(U"array")),
                                 EF,
                                 make<Apply>(
                                     E,
@@ -492,8 +525,6 @@ class Desugarer {
             desugar(ast->left, obj_level);
             desugar(ast->right, obj_level);
 
-            bool invert = false;
-
             switch (ast->op) {
                 case BOP_PERCENT: {
                     AST *f_mod = make<Index>(E, EF, std(), EF, false, str(U"mod"), EF,
@@ -503,15 +534,6 @@ class Desugarer {
                                               false, EF, EF, false);
                 } break;
 
-                case BOP_MANIFEST_UNEQUAL:
-                invert = true;
-                case BOP_MANIFEST_EQUAL: {
-                    ast_ = equals(ast->location, ast->left, ast->right);
-                    if (invert)
-                        ast_ = make<Unary>(ast->location, ast->openFodder, UOP_NOT, ast_);
-                }
-                break;
-
                 default:;
                 // Otherwise don't change it.
             }
@@ -0,0 +1,104 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_source.h"
+
+namespace {
+
+/** Smaller files are read, as mapping them costs more than the copy saves. */
+const size_t MAP_THRESHOLD = 64 * 1024;
+
+}  // namespace
+
+FileSource::~FileSource(void)
+{
+    if (map != nullptr) ::munmap(map, mapLength);
+}
+
+std::shared_ptr<const FileSource> FileSource::open(const std::string &path, bool &found,
+                                                   std::string &err_msg)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        found = false;
+        err_msg = std::strerror(errno);
+        return nullptr;
+    }
+    found = true;
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && size_t(st.st_size) >= MAP_THRESHOLD) {
+        // Reserve zeroed pages past the end of the file, then map the file over the start of
+        // them.  The byte after the content is therefore always a NUL, even when the file
+        // size is a multiple of the page size.
+        size_t length = st.st_size;
+        size_t page = ::sysconf(_SC_PAGESIZE);
+        size_t map_length = (length / page + 1) * page;
+        void *base = ::mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != MAP_FAILED) {
+            if (::mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED) {
+                ::close(fd);
+                std::shared_ptr<FileSource> r(new FileSource());
+                r->content = static_cast<const char*>(base);
+                r->length = length;
+                r->map = base;
+                r->mapLength = map_length;
+                return r;
+            }
+            ::munmap(base, map_length);
+        }
+        // Otherwise read it after all.
+    }
+
+    std::shared_ptr<const FileSource> r = read(fd, err_msg);
+    ::close(fd);
+    return r;
+}
+
+std::shared_ptr<const FileSource> FileSource::read(int fd, std::string &err_msg)
+{
+    std::string str;
+    char chunk[65536];
+    while (true) {
+        ssize_t n = ::read(fd, chunk, sizeof chunk);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            err_msg = std::strerror(errno);
+            return nullptr;
+        }
+        str.append(chunk, n);
+    }
+    return fromString(std::move(str));
+}
+
+std::shared_ptr<const FileSource> FileSource::fromString(std::string str)
+{
+    std::shared_ptr<FileSource> r(new FileSource());
+    r->buffer = std::move(str);
+    r->content = r->buffer.c_str();
+    r->length = r->buffer.length();
+    return r;
+}
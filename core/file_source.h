@@ -0,0 +1,85 @@
+/*
+Copyright 2015 Google Inc. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef JSONLANG_FILE_SOURCE_H
+#define JSONLANG_FILE_SOURCE_H
+
+#include <cstddef>
+
+#include <memory>
+#include <string>
+
+/** The bytes of an input file, shared between the lexer and the import cache.
+ *
+ * Large regular files are mapped into memory rather than read.  Anything else (small files,
+ * pipes, terminals, strings returned by an import callback) is held in a buffer.  Either way
+ * the content is followed by a NUL, so data() can be given to jsonlang_lex as it is.
+ *
+ * A mapped file must not be truncated while it is in use.  Replacing it by renaming another
+ * file over it, as editors and jsonlang -m do, is fine.
+ */
+class FileSource {
+    const char *content;
+    size_t length;
+    /** The mapping, or nullptr if the content is in buffer. */
+    void *map;
+    size_t mapLength;
+    std::string buffer;
+
+    FileSource(void)
+      : content(nullptr), length(0), map(nullptr), mapLength(0)
+    { }
+    FileSource(const FileSource &) = delete;
+    FileSource &operator=(const FileSource &) = delete;
+
+  public:
+    ~FileSource(void);
+
+    /** Load the file at path.
+     *
+     * \param found Set to false if the file could not be opened, true otherwise.
+     * \param err_msg Set to the reason when nullptr is returned.
+     * \returns The content, or nullptr if the file could not be opened or read.
+     */
+    static std::shared_ptr<const FileSource> open(const std::string &path, bool &found,
+                                                  std::string &err_msg);
+
+    /** Read all of an already open file descriptor, e.g. stdin.  Does not close it. */
+    static std::shared_ptr<const FileSource> read(int fd, std::string &err_msg);
+
+    /** Wrap content that is already in memory. */
+    static std::shared_ptr<const FileSource> fromString(std::string str);
+
+    /** The content, followed by a NUL. */
+    const char *data(void) const
+    {
+        return content;
+    }
+
+    /** The length of the content, not counting the NUL. */
+    size_t size(void) const
+    {
+        return length;
+    }
+
+    /** Whether the content is mapped from the file rather than copied. */
+    bool mapped(void) const
+    {
+        return map != nullptr;
+    }
+};
+
+#endif  // JSONLANG_FILE_SOURCE_H
@@ -34,8 +34,9 @@ limitations under the License.
 #include <cstring>
 #include <cerrno>
 
+#include <algorithm>
 #include <exception>
-#include <fstream>
+#include <memory>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -180,6 +181,10 @@ struct JsonlangVm {
     VmNativeCallbackMap nativeCallbacks;
     void *importCallbackContext;
     bool stringOutput;
+    /** VM_OUTPUT_JSON, VM_OUTPUT_CBOR or VM_OUTPUT_MSGPACK. */
+    VmOutputFormat outputFormat;
+    bool outputCompact;
+    unsigned jobs;
     std::vector<std::string> jpaths;
 
     FmtOpts fmtOpts;
@@ -188,13 +193,26 @@ struct JsonlangVm {
     JsonlangVm(void)
       : gcGrowthTrigger(2.0), maxStack(500), gcMinObjects(1000), maxTrace(20),
         importCallback(default_import_callback), importCallbackContext(this), stringOutput(false),
-        fmtDebugDesugaring(false)
+        outputFormat(VM_OUTPUT_JSON), outputCompact(false), jobs(1), fmtDebugDesugaring(false)
     {
         jpaths.emplace_back("/usr/share/" + std::string(jsonlang_version()) + "/");
         jpaths.emplace_back("/usr/local/share/" + std::string(jsonlang_version()) + "/");
     }
 };
 
+/** The format in which to manifest the output of vm. */
+static VmOutputFormat output_format(const JsonlangVm *vm)
+{
+    if (vm->outputFormat == VM_OUTPUT_JSON && vm->outputCompact) return VM_OUTPUT_JSON_COMPACT;
+    return vm->outputFormat;
+}
+
+/** Whether the output of vm is binary, rather than text ending in a newline. */
+static bool binary_output(const JsonlangVm *vm)
+{
+    return vm->outputFormat != VM_OUTPUT_JSON && !vm->stringOutput;
+}
+
 enum ImportStatus {
     IMPORT_STATUS_OK,
     IMPORT_STATUS_FILE_NOT_FOUND,
@@ -202,8 +220,8 @@ enum ImportStatus {
 };
 
 static enum ImportStatus try_path(const std::string &dir, const std::string &rel,
-                                  std::string &content, std::string &found_here,
-                                  std::string &err_msg)
+                                  std::shared_ptr<const FileSource> &content,
+                                  std::string &found_here, std::string &err_msg)
 {
     std::string abs_path;
     if (rel.length() == 0) {
@@ -222,58 +240,68 @@ static enum ImportStatus try_path(const std::string &dir, const std::string &rel
         return IMPORT_STATUS_IO_ERROR;
     }
 
-    std::ifstream f;
-    f.open(abs_path.c_str());
-    if (!f.good()) return IMPORT_STATUS_FILE_NOT_FOUND;
-    try {
-        content.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
-    } catch (const std::ios_base::failure &io_err) {
-        err_msg = io_err.what();
-        return IMPORT_STATUS_IO_ERROR;
-    }
-    if (!f.good()) {
-        err_msg = strerror(errno);
-        return IMPORT_STATUS_IO_ERROR;
-    }
+    bool found;
+    content = FileSource::open(abs_path, found, err_msg);
+    if (!found) return IMPORT_STATUS_FILE_NOT_FOUND;
+    if (content == nullptr) return IMPORT_STATUS_IO_ERROR;
 
     found_here = abs_path;
 
     return IMPORT_STATUS_OK;
 }
 
-static char *default_import_callback(void *ctx, const char *dir, const char *file,
-                                     char **found_here_cptr, int *success)
+/** The default import callback, as used by the VM, which keeps the file rather than a copy. */
+static std::shared_ptr<const FileSource> default_import_loader(void *ctx, const std::string &dir,
+                                                               const std::string &rel,
+                                                               std::string &found_here,
+                                                               std::string &err_msg)
 {
     auto *vm = static_cast<JsonlangVm*>(ctx);
 
-    std::string input, found_here, err_msg;
+    std::shared_ptr<const FileSource> input;
 
-    ImportStatus status = try_path(dir, file, input, found_here, err_msg);
+    ImportStatus status = try_path(dir, rel, input, found_here, err_msg);
 
     std::vector<std::string> jpaths(vm->jpaths);
 
     // If not found, try library search path.
     while (status == IMPORT_STATUS_FILE_NOT_FOUND) {
         if (jpaths.size() == 0) {
-            *success = 0;
-            const char *err = "No match locally or in the Jsonlang library paths.";
-            char *r = jsonlang_realloc(vm, nullptr, std::strlen(err) + 1);
-            std::strcpy(r, err);
-            return r;
+            err_msg = "No match locally or in the Jsonlang library paths.";
+            return nullptr;
         }
-        status = try_path(jpaths.back(), file, input, found_here, err_msg);
+        status = try_path(jpaths.back(), rel, input, found_here, err_msg);
         jpaths.pop_back();
     }
 
-    if (status == IMPORT_STATUS_IO_ERROR) {
+    if (status == IMPORT_STATUS_IO_ERROR) return nullptr;
+    assert(status == IMPORT_STATUS_OK);
+    return input;
+}
+
+static char *default_import_callback(void *ctx, const char *dir, const char *file,
+                                     char **found_here_cptr, int *success)
+{
+    auto *vm = static_cast<JsonlangVm*>(ctx);
+
+    std::string found_here, err_msg;
+    std::shared_ptr<const FileSource> input =
+        default_import_loader(ctx, dir, file, found_here, err_msg);
+
+    if (input == nullptr) {
         *success = 0;
         return from_string(vm, err_msg);
-    } else {
-        assert(status == IMPORT_STATUS_OK);
-        *success = 1;
-        *found_here_cptr = from_string(vm, found_here);
-        return from_string(vm, input);
     }
+    *success = 1;
+    *found_here_cptr = from_string(vm, found_here);
+    return from_string(vm, input->data());
+}
+
+/** The loader to give the VM: the default one unless the user has set an import callback. */
+static VmImportLoader *import_loader(const JsonlangVm *vm)
+{
+    if (vm->importCallback != default_import_callback) return nullptr;
+    return default_import_loader;
 }
 
 #define TRY try {
@@ -326,6 +354,30 @@ void jsonlang_string_output(struct JsonlangVm *vm, int v)
     vm->stringOutput = bool(v);
 }
 
+void jsonlang_output_compact(struct JsonlangVm *vm, int v)
+{
+    vm->outputCompact = bool(v);
+}
+
+int jsonlang_output_format(struct JsonlangVm *vm, const char *format)
+{
+    if (!strcmp(format, "json")) {
+        vm->outputFormat = VM_OUTPUT_JSON;
+    } else if (!strcmp(format, "cbor")) {
+        vm->outputFormat = VM_OUTPUT_CBOR;
+    } else if (!strcmp(format, "msgpack")) {
+        vm->outputFormat = VM_OUTPUT_MSGPACK;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+void jsonlang_jobs(struct JsonlangVm *vm, unsigned v)
+{
+    vm->jobs = v;
+}
+
 void jsonlang_import_callback(struct JsonlangVm *vm, JsonlangImportCallback *cb, void *ctx)
 {
     vm->importCallback = cb;
@@ -456,19 +508,18 @@ static char *jsonlang_fmt_snippet_aux(JsonlangVm *vm, const char *filename, cons
 char *jsonlang_fmt_file(JsonlangVm *vm, const char *filename, int *error)
 {
     TRY
-        std::ifstream f;
-        f.open(filename);
-        if (!f.good()) {
+        bool found;
+        std::string err_msg;
+        std::shared_ptr<const FileSource> input = FileSource::open(filename, found, err_msg);
+        if (input == nullptr) {
             std::stringstream ss;
-            ss << "Opening input file: " << filename << ": " << strerror(errno);
+            ss << (found ? "Reading" : "Opening") << " input file: " << filename << ": "
+               << err_msg;
             *error = true;
             return from_string(vm, ss.str());
         }
-        std::string input;
-        input.assign(std::istreambuf_iterator<char>(f),
-                     std::istreambuf_iterator<char>());
 
-        return jsonlang_fmt_snippet_aux(vm, filename, input.c_str(), error);
+        return jsonlang_fmt_snippet_aux(vm, filename, input->data(), error);
     CATCH("jsonlang_fmt_file")
     return nullptr;  // Never happens.
 }
@@ -484,10 +535,89 @@ char *jsonlang_fmt_snippet(JsonlangVm *vm, const char *filename, const char *sni
 
 namespace {
 enum EvalKind { REGULAR, MULTI, STREAM };
+
+/** Builds the output in a buffer from jsonlang_realloc, so it can be returned without a copy.
+ */
+struct BufferOutput : public VmOutput {
+    JsonlangVm *vm;
+    char *buf;
+    size_t len;
+    size_t capacity;
+    BufferOutput(JsonlangVm *vm)
+      : vm(vm), buf(nullptr), len(0), capacity(0)
+    { }
+    ~BufferOutput()
+    {
+        if (buf != nullptr) jsonlang_realloc(vm, buf, 0);
+    }
+    void write(const char *data, size_t data_len)
+    {
+        // Leave room for the terminating '\0'.
+        if (len + data_len + 1 > capacity) {
+            capacity = std::max(2 * capacity, len + data_len + 1);
+            buf = jsonlang_realloc(vm, buf, capacity);
+        }
+        std::memcpy(buf + len, data, data_len);
+        len += data_len;
+    }
+    /** Terminates the output and hands it over to the caller. */
+    char *release(void)
+    {
+        write("", 0);
+        buf[len] = '\0';
+        char *r = buf;
+        buf = nullptr;
+        return r;
+    }
+};
+
+/** Passes the output on to the callbacks of the jsonlang_evaluate_*_write functions.
+ */
+struct CallbackOutput : public VmOutput {
+    JsonlangDocumentCallback *beginCb;
+    JsonlangWriteCallback *writeCb;
+    JsonlangDocumentCallback *endCb;
+    void *ctx;
+    /** The name given to beginDocument, for endCb. */
+    std::string name;
+    bool named;
+    /** Whether to end each document with a newline, i.e. whether the output is text. */
+    bool newline;
+    CallbackOutput(JsonlangVm *vm, JsonlangDocumentCallback *begin_cb,
+                   JsonlangWriteCallback *write_cb, JsonlangDocumentCallback *end_cb, void *ctx)
+      : beginCb(begin_cb), writeCb(write_cb), endCb(end_cb), ctx(ctx), named(false),
+        newline(!binary_output(vm))
+    { }
+    void check(int r)
+    {
+        if (r != 0) throw RuntimeError(std::vector<TraceFrame>(), "Output callback failed.");
+    }
+    void write(const char *data, size_t len)
+    {
+        check(writeCb(ctx, data, len));
+    }
+    void beginDocument(const char *name_)
+    {
+        named = name_ != nullptr;
+        if (named) name = name_;
+        if (beginCb != nullptr) check(beginCb(ctx, name_));
+    }
+    void endDocument(void)
+    {
+        // As in the buffers of jsonlang_evaluate_snippet_multi / _stream.
+        if (newline) write("\n", 1);
+        if (endCb != nullptr) check(endCb(ctx, named ? name.c_str() : nullptr));
+    }
+};
 }  // namespace
 
+/** Evaluates the snippet, returning the output in a buffer unless output is given.
+ *
+ * \param output If not nullptr, receives the output, and only errors are returned.
+ */
 static char *jsonlang_evaluate_snippet_aux(JsonlangVm *vm, const char *filename,
-                                          const char *snippet, int *error, EvalKind kind)
+                                          const char *snippet, int *error, EvalKind kind,
+                                          VmOutput *output=nullptr)
 {
     try {
         Allocator alloc;
@@ -499,23 +629,51 @@ static char *jsonlang_evaluate_snippet_aux(JsonlangVm *vm, const char *filename,
         jsonlang_desugar(&alloc, expr, &vm->tla);
 
         jsonlang_static_analysis(expr);
+        if (output == nullptr && binary_output(vm)) {
+            // Binary output cannot be returned as a string.
+            throw RuntimeError(std::vector<TraceFrame>(),
+                               "Binary output formats need the jsonlang_evaluate_*_write "
+                               "functions.");
+        }
         switch (kind) {
             case REGULAR: {
-                std::string json_str = jsonlang_vm_execute(
+                if (output != nullptr) {
+                    jsonlang_vm_execute(
+                        &alloc, expr, vm->ext, vm->maxStack, vm->gcMinObjects,
+                        vm->gcGrowthTrigger, vm->nativeCallbacks, vm->importCallback,
+                        vm->importCallbackContext, import_loader(vm), vm->stringOutput,
+                        output_format(vm), *output);
+                    if (!binary_output(vm)) output->write("\n", 1);
+                    *error = false;
+                    return nullptr;
+                }
+                BufferOutput buffer(vm);
+                jsonlang_vm_execute(
                     &alloc, expr, vm->ext, vm->maxStack, vm->gcMinObjects,
                     vm->gcGrowthTrigger, vm->nativeCallbacks, vm->importCallback,
-                    vm->importCallbackContext, vm->stringOutput);
-                json_str += "\n";
+                    vm->importCallbackContext, import_loader(vm), vm->stringOutput,
+                    output_format(vm), buffer);
+                buffer.write("\n", 1);
                 *error = false;
-                return from_string(vm, json_str);
+                return buffer.release();
             }
             break;
 
             case MULTI: {
+                if (output != nullptr) {
+                    jsonlang_vm_execute_multi(
+                        &alloc, expr, vm->ext, vm->maxStack, vm->gcMinObjects,
+                        vm->gcGrowthTrigger, vm->nativeCallbacks, vm->importCallback,
+                        vm->importCallbackContext, import_loader(vm), vm->stringOutput,
+                        output_format(vm), vm->jobs, *output);
+                    *error = false;
+                    return nullptr;
+                }
                 std::map<std::string, std::string> files = jsonlang_vm_execute_multi(
                     &alloc, expr, vm->ext, vm->maxStack, vm->gcMinObjects,
                     vm->gcGrowthTrigger, vm->nativeCallbacks, vm->importCallback,
-                    vm->importCallbackContext, vm->stringOutput);
+                    vm->importCallbackContext, import_loader(vm), vm->stringOutput,
+                    output_format(vm), vm->jobs);
                 size_t sz = 1; // final sentinel
                 for (const auto &pair : files) {
                     sz += pair.first.length() + 1; // include sentinel
@@ -541,10 +699,18 @@ static char *jsonlang_evaluate_snippet_aux(JsonlangVm *vm, const char *filename,
             break;
 
             case STREAM: {
+                if (output != nullptr) {
+                    jsonlang_vm_execute_stream(
+                        &alloc, expr, vm->ext, vm->maxStack, vm->gcMinObjects,
+                        vm->gcGrowthTrigger, vm->nativeCallbacks, vm->importCallback,
+                        vm->importCallbackContext, import_loader(vm), output_format(vm), *output);
+                    *error = false;
+                    return nullptr;
+                }
                 std::vector<std::string> documents = jsonlang_vm_execute_stream(
                     &alloc, expr, vm->ext, vm->maxStack, vm->gcMinObjects,
                     vm->gcGrowthTrigger, vm->nativeCallbacks, vm->importCallback,
-                    vm->importCallbackContext);
+                    vm->importCallbackContext, import_loader(vm), output_format(vm));
                 size_t sz = 1; // final sentinel
                 for (const auto &doc : documents) {
                     sz += doc.length() + 2; // Add a '\n' as well as sentinel
@@ -599,21 +765,20 @@ static char *jsonlang_evaluate_snippet_aux(JsonlangVm *vm, const char *filename,
     return nullptr;  // Quiet, compiler.
 }
 
-static char *jsonlang_evaluate_file_aux(JsonlangVm *vm, const char *filename, int *error, EvalKind kind)
+static char *jsonlang_evaluate_file_aux(JsonlangVm *vm, const char *filename, int *error, EvalKind kind,
+                                       VmOutput *output=nullptr)
 {
-    std::ifstream f;
-    f.open(filename);
-    if (!f.good()) {
+    bool found;
+    std::string err_msg;
+    std::shared_ptr<const FileSource> input = FileSource::open(filename, found, err_msg);
+    if (input == nullptr) {
         std::stringstream ss;
-        ss << "Opening input file: " << filename << ": " << strerror(errno);
+        ss << (found ? "Reading" : "Opening") << " input file: " << filename << ": " << err_msg;
         *error = true;
         return from_string(vm, ss.str());
     }
-    std::string input;
-    input.assign(std::istreambuf_iterator<char>(f),
-                 std::istreambuf_iterator<char>());
 
-    return jsonlang_evaluate_snippet_aux(vm, filename, input.c_str(), error, kind);
+    return jsonlang_evaluate_snippet_aux(vm, filename, input->data(), error, kind, output);
 }
 
 char *jsonlang_evaluate_file(JsonlangVm *vm, const char *filename, int *error)
@@ -666,6 +831,76 @@ char *jsonlang_evaluate_snippet_stream(JsonlangVm *vm, const char *filename,
     return nullptr;  // Never happens.
 }
 
+char *jsonlang_evaluate_file_write(JsonlangVm *vm, const char *filename,
+                                  JsonlangWriteCallback *write, void *ctx, int *error)
+{
+    TRY
+    CallbackOutput output(vm, nullptr, write, nullptr, ctx);
+    return jsonlang_evaluate_file_aux(vm, filename, error, REGULAR, &output);
+    CATCH("jsonlang_evaluate_file_write")
+    return nullptr;  // Never happens.
+}
+
+char *jsonlang_evaluate_snippet_write(JsonlangVm *vm, const char *filename, const char *snippet,
+                                     JsonlangWriteCallback *write, void *ctx, int *error)
+{
+    TRY
+    CallbackOutput output(vm, nullptr, write, nullptr, ctx);
+    return jsonlang_evaluate_snippet_aux(vm, filename, snippet, error, REGULAR, &output);
+    CATCH("jsonlang_evaluate_snippet_write")
+    return nullptr;  // Never happens.
+}
+
+char *jsonlang_evaluate_file_multi_write(JsonlangVm *vm, const char *filename,
+                                        JsonlangDocumentCallback *begin,
+                                        JsonlangWriteCallback *write,
+                                        JsonlangDocumentCallback *end, void *ctx, int *error)
+{
+    TRY
+    CallbackOutput output(vm, begin, write, end, ctx);
+    return jsonlang_evaluate_file_aux(vm, filename, error, MULTI, &output);
+    CATCH("jsonlang_evaluate_file_multi_write")
+    return nullptr;  // Never happens.
+}
+
+char *jsonlang_evaluate_snippet_multi_write(JsonlangVm *vm, const char *filename,
+                                           const char *snippet,
+                                           JsonlangDocumentCallback *begin,
+                                           JsonlangWriteCallback *write,
+                                           JsonlangDocumentCallback *end, void *ctx, int *error)
+{
+    TRY
+    CallbackOutput output(vm, begin, write, end, ctx);
+    return jsonlang_evaluate_snippet_aux(vm, filename, snippet, error, MULTI, &output);
+    CATCH("jsonlang_evaluate_snippet_multi_write")
+    return nullptr;  // Never happens.
+}
+
+char *jsonlang_evaluate_file_stream_write(JsonlangVm *vm, const char *filename,
+                                         JsonlangDocumentCallback *begin,
+                                         JsonlangWriteCallback *write,
+                                         JsonlangDocumentCallback *end, void *ctx, int *error)
+{
+    TRY
+    CallbackOutput output(vm, begin, write, end, ctx);
+    return jsonlang_evaluate_file_aux(vm, filename, error, STREAM, &output);
+    CATCH("jsonlang_evaluate_file_stream_write")
+    return nullptr;  // Never happens.
+}
+
+char *jsonlang_evaluate_snippet_stream_write(JsonlangVm *vm, const char *filename,
+                                            const char *snippet,
+                                            JsonlangDocumentCallback *begin,
+                                            JsonlangWriteCallback *write,
+                                            JsonlangDocumentCallback *end, void *ctx, int *error)
+{
+    TRY
+    CallbackOutput output(vm, begin, write, end, ctx);
+    return jsonlang_evaluate_snippet_aux(vm, filename, snippet, error, STREAM, &output);
+    CATCH("jsonlang_evaluate_snippet_stream_write")
+    return nullptr;  // Never happens.
+}
+
 char *jsonlang_realloc(JsonlangVm *vm, char *str, size_t sz)
 {
     (void) vm;
@@ -14,7 +14,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <cmath>
 
@@ -22,7 +24,6 @@ limitations under the License.
 #include <set>
 #include <sstream>
 #include <string>
-#include <iomanip>
 
 
 #include "ast.h"
@@ -32,19 +33,67 @@ limitations under the License.
 #include "static_error.h"
 
 
-std::string jsonlang_unparse_number(double v)
+namespace {
+
+/** Enough for the 309 digits of the largest double printed with %.0f, and a sign. */
+const size_t UNPARSE_NUMBER_BUFSIZE = 320;
+
+/** Writes jsonlang_unparse_number(v) into buf and returns its length.
+ *
+ * This is the output that std::stringstream used to give, without its allocations.
+ */
+size_t unparse_number(double v, char *buf)
 {
-    std::stringstream ss;
+    if (v == floor(v) && std::fabs(v) < 1e18) {
+        // Exact in an unsigned long long, so print the digits directly.
+        char *end = buf + UNPARSE_NUMBER_BUFSIZE;
+        char *p = end;
+        unsigned long long n = std::fabs(v);
+        do {
+            *--p = '0' + n % 10;
+            n /= 10;
+        } while (n > 0);
+        // Includes -0, as std::fixed prints it.
+        if (std::signbit(v)) *--p = '-';
+        size_t len = end - p;
+        std::memmove(buf, p, len);
+        return len;
+    }
+    int len;
     if (v == floor(v)) {
-        ss << std::fixed << std::setprecision(0) << v;
+        len = std::snprintf(buf, UNPARSE_NUMBER_BUFSIZE, "%.0f", v);
     } else {
         // See "What Every Computer Scientist Should Know About Floating-Point Arithmetic"
         // Theorem 15
         // http://docs.oracle.com/cd/E19957-01/806-3568/ncg_goldberg.html
-        ss << std::setprecision(17);
-        ss << v;
+        len = std::snprintf(buf, UNPARSE_NUMBER_BUFSIZE, "%.17g", v);
+    }
+    // Unlike the stream, printf follows the C locale, whose decimal point need not be '.'.
+    size_t j = 0;
+    for (int i = 0 ; i < len ; ++i) {
+        char c = buf[i];
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+') {
+            // Letters are the exponent, or the inf and nan that cannot be manifested anyway.
+            buf[j++] = c;
+        } else if (j == 0 || buf[j - 1] != '.') {
+            buf[j++] = '.';
+        }
     }
-    return ss.str();
+    return j;
+}
+
+}  // namespace
+
+std::string jsonlang_unparse_number(double v)
+{
+    char buf[UNPARSE_NUMBER_BUFSIZE];
+    return std::string(buf, unparse_number(v, buf));
+}
+
+void jsonlang_unparse_number(double v, String &out)
+{
+    char buf[UNPARSE_NUMBER_BUFSIZE];
+    out.append(buf, buf + unparse_number(v, buf));
 }
 
 
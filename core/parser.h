@@ -36,6 +36,10 @@ AST *jsonlang_parse(Allocator *alloc, Tokens &tokens);
  */
 std::string jsonlang_unparse_number(double v);
 
+/** Appends jsonlang_unparse_number(v) to out, without building an intermediate string.
+ */
+void jsonlang_unparse_number(double v, String &out);
+
 /** The inverse of jsonlang_parse.
  */
 std::string jsonlang_unparse_jsonlang(const AST *ast, const Fodder &final_fodder, unsigned indent,
@@ -16,7 +16,14 @@ limitations under the License.
 
 #include "parser.h"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
 #include <list>
+#include <random>
+#include <sstream>
 #include "ast.h"
 #include "lexer.h"
 #include "gtest/gtest.h"
@@ -395,4 +402,65 @@ TEST(Parser, TestInvalidOverride)
     testParseError( "a{b c}", R"(test:1:5: Expected token OPERATOR but got (IDENTIFIER, "c"))");
 }
 
+// The formatting jsonlang_unparse_number had before it stopped using a stream.
+std::string streamUnparseNumber(double v)
+{
+    std::stringstream ss;
+    if (v == floor(v)) {
+        ss << std::fixed << std::setprecision(0) << v;
+    } else {
+        ss << std::setprecision(17);
+        ss << v;
+    }
+    return ss.str();
+}
+
+void testUnparseNumber(double v)
+{
+    std::string expected = streamUnparseNumber(v);
+    EXPECT_EQ(expected, jsonlang_unparse_number(v)) << std::hexfloat << v;
+    String out = U"x";
+    jsonlang_unparse_number(v, out);
+    EXPECT_TRUE(out == U"x" + String(expected.begin(), expected.end())) << expected;
+}
+
+TEST(Parser, TestUnparseNumber)
+{
+    for (double v : {0.0, -0.0, 1.0, -1.0, 0.1, -0.1, 0.5, 1e-300, 5e-324, -5e-324, 1e17,
+                     1e18, -1e18, 1e19, 1e300, -1e300, std::numeric_limits<double>::max(),
+                     -std::numeric_limits<double>::max(), 9007199254740993.0}) {
+        testUnparseNumber(v);
+    }
+
+    // Integers either side of 1e18, where the digit loop hands over to printf.
+    for (double base : {1e18, -1e18}) {
+        double up = base, down = base;
+        for (int i = 0 ; i < 1000 ; ++i) {
+            testUnparseNumber(up);
+            testUnparseNumber(down);
+            up = std::nextafter(up, HUGE_VAL);
+            down = std::nextafter(down, -HUGE_VAL);
+        }
+    }
+
+    std::mt19937_64 rng(42);
+    // Any finite bit pattern, so every exponent and sign.
+    for (int i = 0 ; i < 100000 ; ++i) {
+        uint64_t bits = rng();
+        double v;
+        std::memcpy(&v, &bits, sizeof v);
+        if (std::isfinite(v)) testUnparseNumber(v);
+    }
+    // Integers and halves of every magnitude up to 2^63, positive and negative.
+    for (int i = 0 ; i < 100000 ; ++i) {
+        double v = std::ldexp(double(rng() >> (rng() % 64)), -int(rng() % 2));
+        testUnparseNumber(rng() % 2 ? v : -v);
+    }
+    // Ordinary fractions.
+    std::uniform_real_distribution<double> real(-1e6, 1e6);
+    for (int i = 0 ; i < 100000 ; ++i) {
+        testUnparseNumber(real(rng));
+    }
+}
+
 }  // namespace
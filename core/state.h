@@ -17,6 +17,8 @@ limitations under the License.
 #ifndef JSONLANG_STATE_H
 #define JSONLANG_STATE_H
 
+#include "file_source.h"
+
 namespace {
 
 /** Mark & sweep: advanced by 1 each GC cycle.
@@ -85,13 +87,75 @@ struct HeapThunk;
 
 /** Stores the values bound to variables.
  *
- * Each nested local statement, function call, and field access has its own binding frame to
- * give the values for the local variable, function parameters, or upValues.
+ * Each nested local statement, function call, and comprehension element has its own binding
+ * frame to give the values for the local variables, function parameters, or loop variable.
  */
 typedef std::map<const Identifier*, HeapThunk*> BindingFrame;
 
+/** An environment, i.e. the variables that are in scope at some point in the program.
+ *
+ * Each level holds one BindingFrame and points at the enclosing environment.  Closures, thunks
+ * and objects capture their environment by pointer, so capturing is O(1) and an environment is
+ * shared (and traced by the garbage collector once) however many values captured it.
+ *
+ * The bindings are filled in by the construct that creates the environment and are not
+ * changed afterwards.
+ */
+struct HeapEnv : public HeapEntity {
+    /** The enclosing environment, or nullptr at the top level. */
+    HeapEnv * const parent;
+
+    /** The variables introduced at this level. */
+    BindingFrame bindings;
+
+    HeapEnv(HeapEnv *parent)
+      : parent(parent)
+    { }
+
+    HeapEnv(HeapEnv *parent, const BindingFrame &bindings)
+      : parent(parent), bindings(bindings)
+    { }
+
+    /** Search for the closest binding of the given variable, or nullptr. */
+    HeapThunk *lookUp(const Identifier *id) const
+    {
+        for (const HeapEnv *env = this ; env != nullptr ; env = env->parent) {
+            auto it = env->bindings.find(id);
+            if (it != env->bindings.end()) return it->second;
+        }
+        return nullptr;
+    }
+};
+
+struct HeapArray;
+
+/** The fields of an object, worked out from its leaves the first time they are needed.
+ *
+ * Objects do not change once they are constructed, so neither does this.
+ */
+struct ObjectFieldIndex {
+    /** Every field, hidden or not, with the visibility it has in the object. */
+    std::unordered_map<const Identifier*, ObjectField::Hide> hide;
+    /** How many of those fields are not hidden. */
+    unsigned numVisible;
+    /** The results of std.objectFieldsEx without and with hidden fields, once asked for. */
+    HeapArray *visibleNames;
+    HeapArray *allNames;
+    ObjectFieldIndex(void)
+      : numVisible(0), visibleNames(nullptr), allNames(nullptr)
+    { }
+};
+
 /** Supertype of all objects.  Types of Value::OBJECT will point at these.  */
 struct HeapObject : public HeapEntity {
+    /** Whether hash holds the structural hash of the object.  \see HeapArray::hashed */
+    bool hashed;
+    size_t hash;
+    /** Null until the fields are first needed.  \see Interpreter::objectFieldIndex */
+    mutable std::unique_ptr<ObjectFieldIndex> fieldIndex;
+    HeapObject(void)
+      : hashed(false), hash(0)
+    { }
 };
 
 /** Hold an unevaluated expression.  This implements lazy semantics.
@@ -108,9 +172,9 @@ struct HeapThunk : public HeapEntity {
 
     /** The captured environment.
      *
-     * Note, this is non-const because we have to add cyclic references to it.
+     * Note, this is non-const because it is set after creation, to make cyclic references.
      */
-    BindingFrame upValues;
+    HeapEnv *upValues;
 
     /** The captured self variable, or nullptr if there was none.  \see CallFrame. */
     HeapObject *self;
@@ -122,7 +186,7 @@ struct HeapThunk : public HeapEntity {
     const AST *body;
 
     HeapThunk(const Identifier *name, HeapObject *self, unsigned offset, const AST *body)
-      : filled(false), name(name), self(self), offset(offset), body(body)
+      : filled(false), name(name), upValues(nullptr), self(self), offset(offset), body(body)
     { }
 
     void fill(const Value &v)
@@ -130,7 +194,7 @@ struct HeapThunk : public HeapEntity {
         content = v;
         filled = true;
         self = nullptr;
-        upValues.clear();
+        upValues = nullptr;
     }
 };
 
@@ -139,8 +203,17 @@ struct HeapArray : public HeapEntity {
     // time after creation.  Thus, elements are not GCed as the array is being
     // created.
     std::vector<HeapThunk*> elements;
+
+    /** Whether hash holds the structural hash of the elements.
+     *
+     * The hash is computed on demand, and only once every element has been forced, so it never
+     * needs to be invalidated.
+     */
+    bool hashed;
+    size_t hash;
+
     HeapArray(const std::vector<HeapThunk*> &elements)
-      : elements(elements)
+      : elements(elements), hashed(false), hash(0)
     { }
 };
 
@@ -151,7 +224,7 @@ struct HeapLeafObject : public HeapObject {
 /** Objects created via the simple object constructor construct. */
 struct HeapSimpleObject : public HeapLeafObject {
     /** The captured environment. */
-    const BindingFrame upValues;
+    HeapEnv * const upValues;
 
     struct Field {
         /** Will the field appear in output? */
@@ -173,7 +246,7 @@ struct HeapSimpleObject : public HeapLeafObject {
      */
     std::vector<AST*> asserts;
 
-    HeapSimpleObject(const BindingFrame &up_values,
+    HeapSimpleObject(HeapEnv *up_values,
                      const std::map<const Identifier*, Field> fields, std::vector<AST*> asserts)
       : upValues(up_values), fields(fields), asserts(asserts)
     { }
@@ -196,7 +269,7 @@ struct HeapExtendedObject : public HeapObject {
 struct HeapComprehensionObject : public HeapLeafObject {
 
     /** The captured environment. */
-    const BindingFrame upValues;
+    HeapEnv * const upValues;
 
     /** The expression used to compute the field values.  */
     const AST* value;
@@ -215,10 +288,16 @@ struct HeapComprehensionObject : public HeapLeafObject {
      */
     std::map<const Identifier*, HeapThunk*> compValues;
 
-    HeapComprehensionObject(const BindingFrame &up_values, const AST *value,
+    /** The visibility of every field.  Objects imported from JSON files have the inherited
+     * visibility of the fields of object literals, where the rest are visible.
+     */
+    const ObjectField::Hide hide;
+
+    HeapComprehensionObject(HeapEnv *up_values, const AST *value,
                             const Identifier *id,
-                            const std::map<const Identifier*, HeapThunk*> &comp_values)
-      : upValues(up_values), value(value), id(id), compValues(comp_values)
+                            const std::map<const Identifier*, HeapThunk*> &comp_values,
+                            ObjectField::Hide hide = ObjectField::VISIBLE)
+      : upValues(up_values), value(value), id(id), compValues(comp_values), hide(hide)
     { }
 };
 
@@ -231,7 +310,7 @@ struct HeapComprehensionObject : public HeapLeafObject {
  */
 struct HeapClosure : public HeapEntity {
     /** The captured environment. */
-    const BindingFrame upValues;
+    HeapEnv * const upValues;
     /** The captured self variable, or nullptr if there was none.  \see Frame. */
     HeapObject *self;
     /** The offset from the captured self variable.  \see Frame.*/
@@ -247,7 +326,26 @@ struct HeapClosure : public HeapEntity {
     const Params params;
     const AST *body;
     std::string builtinName;
-    HeapClosure(const BindingFrame &up_values,
+
+    /** Results of earlier calls to a closure made by std.memoize.
+     *
+     * Results are keyed on an encoding of the (forced) arguments, and are only cached when
+     * every argument is a primitive.
+     */
+    struct Memo {
+        std::map<std::string, Value> results;
+        /** Calls answered from results. */
+        unsigned long hits;
+        /** Calls that had to execute the body. */
+        unsigned long misses;
+        Memo(void)
+          : hits(0), misses(0)
+        { }
+    };
+    /** Non-null iff the closure was made by std.memoize. */
+    std::unique_ptr<Memo> memo;
+
+    HeapClosure(HeapEnv *up_values,
                 HeapObject *self,
                 unsigned offset,
                 const Params &params,
@@ -257,12 +355,77 @@ struct HeapClosure : public HeapEntity {
     { }
 };
 
-/** Stores a simple string on the heap. */
+/** One piece of a format string parsed by std.format: literal text or a % conversion. */
+struct FormatCode {
+    /** The conversion type ('d', 'o', 'x', 'e', 'f', 'g', 'c', 's' or '%'), or 0 for text. */
+    char32_t ctype;
+    /** The literal text, or the mapping key of a %(key) conversion. */
+    String text;
+    bool hasMkey;
+    bool alt, zero, left, blank, sign, caps;
+    /** Field width, or * to take it from the values being formatted. */
+    double fw;
+    bool fwStar;
+    /** Precision (if given at all), or * to take it from the values being formatted. */
+    bool hasPrec;
+    double prec;
+    bool precStar;
+    FormatCode(void)
+      : ctype(0), hasMkey(false), alt(false), zero(false), left(false), blank(false),
+        sign(false), caps(false), fw(0), fwStar(false), hasPrec(false), prec(0),
+        precStar(false)
+    { }
+};
+
+/** Stores a simple string on the heap.
+ *
+ * A string made by importstr starts out as the UTF-8 bytes of the file, shared with the import
+ * cache, and is only decoded when its codepoints are needed.  Manifesting it as JSON or as a
+ * string output does not need them.
+ */
 struct HeapString : public HeapEntity {
-    const String value;
+    /** If not nullptr, the first utf8Length bytes of it are the value in UTF-8. */
+    const std::shared_ptr<const FileSource> utf8;
+    const size_t utf8Length;
+    /** The value parsed as a std.format string, filled in the first time it is used as one.
+     *
+     * Format strings are usually literals, which are interned, so this saves parsing them on
+     * every use of %.
+     */
+    mutable std::unique_ptr<const std::vector<FormatCode>> formatCodes;
     HeapString(const String &value)
-      : value(value)
+      : utf8Length(0), decoded(true), str(value), hashed(false), hashCache(0)
     { }
+    /** The bytes must be valid UTF-8 that encode_utf8(decode_utf8(..)) gives back unchanged. */
+    HeapString(const std::shared_ptr<const FileSource> &utf8, size_t utf8_length)
+      : utf8(utf8), utf8Length(utf8_length), decoded(false), hashed(false), hashCache(0)
+    { }
+
+    /** The codepoints of the value, decoded the first time they are needed. */
+    const String &value(void) const
+    {
+        if (!decoded) {
+            str = decode_utf8(std::string(utf8->data(), utf8Length));
+            decoded = true;
+        }
+        return str;
+    }
+
+    /** The hash of the value, computed the first time it is needed. */
+    size_t hash(void) const
+    {
+        if (!hashed) {
+            hashCache = std::hash<String>()(value());
+            hashed = true;
+        }
+        return hashCache;
+    }
+
+    private:
+    mutable bool decoded;
+    mutable String str;
+    mutable bool hashed;
+    mutable size_t hashCache;
 };
 
 /** The heap does memory management, i.e. garbage collection. */
@@ -307,6 +470,15 @@ class Heap {
         vec.push_back(v);
     }
 
+    /** Add the cached field name arrays of obj to vec, if there are any.
+     */
+    void addFieldIndex(HeapObject *obj, std::vector<HeapEntity*> &vec)
+    {
+        if (obj->fieldIndex == nullptr) return;
+        if (obj->fieldIndex->visibleNames) vec.push_back(obj->fieldIndex->visibleNames);
+        if (obj->fieldIndex->allNames) vec.push_back(obj->fieldIndex->allNames);
+    }
+
     public:
 
     Heap(unsigned gc_tune_min_objects, double gc_tune_growth_trigger)
@@ -349,40 +521,52 @@ class Heap {
                 curr->mark = thisMark;
 
                 if (auto *obj = dynamic_cast<HeapSimpleObject*>(curr)) {
-                    for (auto upv : obj->upValues)
-                        addIfHeapEntity(upv.second, s.children);
+                    if (obj->upValues)
+                        addIfHeapEntity(obj->upValues, s.children);
+                    addFieldIndex(obj, s.children);
 
                 } else if (auto *obj = dynamic_cast<HeapExtendedObject*>(curr)) {
                     addIfHeapEntity(obj->left, s.children);
                     addIfHeapEntity(obj->right, s.children);
+                    addFieldIndex(obj, s.children);
 
                 } else if (auto *obj = dynamic_cast<HeapComprehensionObject*>(curr)) {
-                    for (auto upv : obj->upValues)
-                        addIfHeapEntity(upv.second, s.children);
+                    if (obj->upValues)
+                        addIfHeapEntity(obj->upValues, s.children);
                     for (auto upv : obj->compValues)
                         addIfHeapEntity(upv.second, s.children);
-
+                    addFieldIndex(obj, s.children);
 
                 } else if (auto *arr = dynamic_cast<HeapArray*>(curr)) {
                     for (auto el : arr->elements)
                         addIfHeapEntity(el, s.children);
 
                 } else if (auto *func = dynamic_cast<HeapClosure*>(curr)) {
-                    for (auto upv : func->upValues)
-                        addIfHeapEntity(upv.second, s.children);
+                    if (func->upValues)
+                        addIfHeapEntity(func->upValues, s.children);
                     if (func->self)
                         addIfHeapEntity(func->self, s.children);
+                    if (func->memo) {
+                        for (const auto &result : func->memo->results)
+                            addIfHeapEntity(result.second, s.children);
+                    }
 
                 } else if (auto *thunk = dynamic_cast<HeapThunk*>(curr)) {
                     if (thunk->filled) {
                         if (thunk->content.isHeap())
                             addIfHeapEntity(thunk->content.v.h, s.children);
                     } else {
-                        for (auto upv : thunk->upValues)
-                            addIfHeapEntity(upv.second, s.children);
+                        if (thunk->upValues)
+                            addIfHeapEntity(thunk->upValues, s.children);
                         if (thunk->self)
                             addIfHeapEntity(thunk->self, s.children);
                     }
+
+                } else if (auto *env = dynamic_cast<HeapEnv*>(curr)) {
+                    if (env->parent)
+                        addIfHeapEntity(env->parent, s.children);
+                    for (auto bind : env->bindings)
+                        addIfHeapEntity(bind.second, s.children);
                 }
             }
 
@@ -16,50 +16,334 @@ limitations under the License.
 
 #include <iomanip>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
 #include "string_utils.h"
 #include "static_error.h"
 
+namespace {
+
+/** The characters that an escaping function rewrites: a and b, and if control is set also
+ * everything below 0x20 and everything from lo to hi.
+ *
+ * Looking for these is the hot loop of escaping, so it is vectorized where possible and the
+ * runs of characters in between are copied in bulk.
+ */
+struct EscapeSet {
+    char32_t a, b;
+    bool control;
+    char32_t lo, hi;
+
+    bool contains(char32_t c) const
+    {
+        return c == a || c == b || (control && (c < 0x20 || (c >= lo && c <= hi)));
+    }
+};
+
+std::size_t scan_scalar(const char32_t *s, std::size_t i, std::size_t n, const EscapeSet &e)
+{
+    for ( ; i < n ; ++i) {
+        if (e.contains(s[i])) break;
+    }
+    return i;
+}
+
+/** The index of the first bit set in a non-zero mask. */
+std::size_t first_lane(int mask)
+{
+    std::size_t r = 0;
+    for ( ; (mask & 1) == 0 ; mask >>= 1) ++r;
+    return r;
+}
+
+#ifdef __SSE2__
+// Code points are at most 0x10ffff, so the signed 32 bit comparisons below are safe.
+std::size_t scan_sse2(const char32_t *s, std::size_t i, std::size_t n, const EscapeSet &e)
+{
+    const __m128i a = _mm_set1_epi32(e.a);
+    const __m128i b = _mm_set1_epi32(e.b);
+    const __m128i space = _mm_set1_epi32(0x20);
+    const __m128i lo = _mm_set1_epi32(e.lo - 1);
+    const __m128i hi = _mm_set1_epi32(e.hi + 1);
+    for ( ; i + 4 <= n ; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi32(v, a), _mm_cmpeq_epi32(v, b));
+        if (e.control) {
+            m = _mm_or_si128(m, _mm_cmplt_epi32(v, space));
+            m = _mm_or_si128(m, _mm_and_si128(_mm_cmpgt_epi32(v, lo), _mm_cmplt_epi32(v, hi)));
+        }
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+        if (mask != 0) return i + first_lane(mask);
+    }
+    return scan_scalar(s, i, n, e);
+}
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSONLANG_ESCAPE_AVX2
+
+/** Like scan_sse2, 8 characters at a time.  Only called if the CPU supports AVX2. */
+__attribute__((target("avx2")))
+std::size_t scan_avx2(const char32_t *s, std::size_t i, std::size_t n, const EscapeSet &e)
+{
+    const __m256i a = _mm256_set1_epi32(e.a);
+    const __m256i b = _mm256_set1_epi32(e.b);
+    const __m256i space = _mm256_set1_epi32(0x20);
+    const __m256i lo = _mm256_set1_epi32(e.lo - 1);
+    const __m256i hi = _mm256_set1_epi32(e.hi + 1);
+    for ( ; i + 8 <= n ; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi32(v, a), _mm256_cmpeq_epi32(v, b));
+        if (e.control) {
+            m = _mm256_or_si256(m, _mm256_cmpgt_epi32(space, v));
+            m = _mm256_or_si256(m, _mm256_and_si256(_mm256_cmpgt_epi32(v, lo),
+                                                    _mm256_cmpgt_epi32(hi, v)));
+        }
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+        if (mask != 0) return i + first_lane(mask);
+    }
+    return scan_scalar(s, i, n, e);
+}
+#endif
+
+/** The index of the first character from i on that is in e, or n. */
+std::size_t scan(const char32_t *s, std::size_t i, std::size_t n, const EscapeSet &e)
+{
+#ifdef JSONLANG_ESCAPE_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) return scan_avx2(s, i, n, e);
+#endif
+#ifdef __SSE2__
+    return scan_sse2(s, i, n, e);
+#else
+    return scan_scalar(s, i, n, e);
+#endif
+}
+
+/** Copy str to out, calling the escape function on each character that is in e. */
+template <class F> void escape(const String &str, const EscapeSet &e, String &out, F escape_char)
+{
+    const char32_t *s = str.data();
+    std::size_t n = str.length();
+    std::size_t i = 0;
+    while (true) {
+        std::size_t j = scan(s, i, n, e);
+        out.append(s + i, j - i);
+        if (j == n) break;
+        escape_char(s[j]);
+        i = j + 1;
+    }
+}
+
+/** The index of the first byte from i on that may start a character that
+ * jsonlang_string_escape_utf8 rewrites, or n.  0xc2 starts U+0080 to U+00BF, of which only
+ * some are escaped, so the caller checks the next byte.
+ */
+std::size_t scan_utf8(const char *s, std::size_t i, std::size_t n)
+{
+#ifdef __SSE2__
+    // Bytes from 0x80 up are negative here, so they are neither below 0x20 nor 0x7f.
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i c2 = _mm_set1_epi8(char(0xc2));
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    for ( ; i + 16 <= n ; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, c2), _mm_cmpeq_epi8(v, del)));
+        m = _mm_or_si128(m, _mm_and_si128(_mm_cmpgt_epi8(v, minus_one),
+                                          _mm_cmplt_epi8(v, space)));
+        int mask = _mm_movemask_epi8(m);
+        if (mask != 0) return i + first_lane(mask);
+    }
+#endif
+    for ( ; i < n ; ++i) {
+        unsigned char c = s[i];
+        if (c < 0x20 || c == '"' || c == '\\' || c == 0x7f || c == 0xc2) break;
+    }
+    return i;
+}
+
+}  // namespace
+
 String jsonlang_string_unparse(const String &str, bool single)
 {
-    StringStream ss;
-    ss << (single ? U'\'' : U'\"');
-	ss << jsonlang_string_escape(str, single);
-    ss << (single ? U'\'' : U'\"');
-	return ss.str();
+    String r;
+    r += single ? U'\'' : U'\"';
+    jsonlang_string_escape(str, single, false, r);
+    r += single ? U'\'' : U'\"';
+    return r;
 }
 
 String jsonlang_string_escape(const String &str, bool single)
 {
-    StringStream ss;
-    for (std::size_t i=0 ; i<str.length() ; ++i) {
-        char32_t c = str[i];
+    String r;
+    jsonlang_string_escape(str, single, false, r);
+    return r;
+}
+
+void jsonlang_string_escape(const String &str, bool single, bool tilde, String &out)
+{
+    static const char32_t hex[] = U"0123456789abcdef";
+    EscapeSet e = {U'\\', single ? U'\'' : U'\"', true, tilde ? char32_t(0x7e) : char32_t(0x7f),
+                   char32_t(0x9f)};
+    escape(str, e, out, [&out](char32_t c) {
         switch (c) {
-            case U'\"': ss << (single ? U"\"" : U"\\\""); break;
-            case U'\'': ss << (single ? U"\\\'" : U"\'"); break;
-            case U'\\': ss << U"\\\\"; break;
-            case U'\b': ss << U"\\b"; break;
-            case U'\f': ss << U"\\f"; break;
-            case U'\n': ss << U"\\n"; break;
-            case U'\r': ss << U"\\r"; break;
-            case U'\t': ss << U"\\t"; break;
-            case U'\0': ss << U"\\u0000"; break;
-            default: {
-                if (c < 0x20 || (c >= 0x7f && c <= 0x9f)) {
-                    //Unprintable, use \u
-                    std::stringstream ss8;
-                    ss8 << "\\u" << std::hex << std::setfill('0') << std::setw(4)
-                       << (unsigned long)(c);
-                    ss << decode_utf8(ss8.str());
-                } else {
-                    // Printable, write verbatim
-                    ss << c;
-                }
+            case U'\"': out += U"\\\""; break;
+            case U'\'': out += U"\\\'"; break;
+            case U'\\': out += U"\\\\"; break;
+            case U'\b': out += U"\\b"; break;
+            case U'\f': out += U"\\f"; break;
+            case U'\n': out += U"\\n"; break;
+            case U'\r': out += U"\\r"; break;
+            case U'\t': out += U"\\t"; break;
+            default:
+            // Unprintable, all of which are below 0xa0.
+            out += U"\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+        }
+    });
+}
+
+void jsonlang_string_escape_utf8(const char *str, std::size_t len, std::string &out)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::size_t i = 0;
+    while (true) {
+        std::size_t j = scan_utf8(str, i, len);
+        out.append(str + i, j - i);
+        if (j == len) break;
+        unsigned char c = str[j];
+        i = j + 1;
+        if (c == 0xc2) {
+            // U+0080 to U+009F are escaped, the rest of U+0080 to U+00BF are not.
+            unsigned char c1 = i < len ? str[i] : 0;
+            if (c1 < 0x80 || c1 > 0x9f) {
+                out += char(c);
+                continue;
             }
+            c = c1;
+            i++;
         }
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+        }
+    }
+}
+
+void jsonlang_string_escape_bash(const String &str, String &out)
+{
+    EscapeSet e = {U'\'', U'\'', false, 0, 0};
+    escape(str, e, out, [&out](char32_t) { out += U"'\"'\"'"; });
+}
+
+void jsonlang_string_escape_dollars(const String &str, String &out)
+{
+    EscapeSet e = {U'$', U'$', false, 0, 0};
+    escape(str, e, out, [&out](char32_t) { out += U"$$"; });
+}
+
+namespace {
+
+const char base64_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/** The inverse of base64_table, with 0xff for characters not in it. */
+struct Base64Inverse {
+    unsigned char v[256];
+    Base64Inverse()
+    {
+        for (auto &x : v) x = 0xff;
+        for (unsigned char i = 0 ; i < 64 ; ++i) v[(unsigned char)(base64_table[i])] = i;
+    }
+    unsigned char operator[](char32_t c) const
+    {
+        return c < 256 ? v[c] : 0xff;
+    }
+};
+
+const Base64Inverse base64_inv;
+
+}  // namespace
+
+void jsonlang_base64_encode(const std::string &bytes, String &out)
+{
+    const auto *b = reinterpret_cast<const unsigned char*>(bytes.data());
+    std::size_t n = bytes.length();
+    std::size_t o = out.length();
+    out.resize(o + (n + 2) / 3 * 4);
+    char32_t *p = &out[o];
+    std::size_t i = 0;
+    // Each 3 bytes make 4 characters.
+    for ( ; i + 3 <= n ; i += 3) {
+        unsigned long w = (b[i] << 16) | (b[i + 1] << 8) | b[i + 2];
+        *p++ = base64_table[w >> 18];
+        *p++ = base64_table[(w >> 12) & 63];
+        *p++ = base64_table[(w >> 6) & 63];
+        *p++ = base64_table[w & 63];
+    }
+    if (i + 1 == n) {
+        *p++ = base64_table[b[i] >> 2];
+        *p++ = base64_table[(b[i] & 3) << 4];
+        *p++ = U'=';
+        *p++ = U'=';
+    } else if (i + 2 == n) {
+        *p++ = base64_table[b[i] >> 2];
+        *p++ = base64_table[((b[i] & 3) << 4) | (b[i + 1] >> 4)];
+        *p++ = base64_table[(b[i + 1] & 15) << 2];
+        *p++ = U'=';
     }
-    return ss.str();
 }
 
+std::size_t jsonlang_base64_decode(const String &str, std::string &out)
+{
+    const char32_t *s = str.data();
+    std::size_t n = str.length();
+    out.reserve(out.length() + n / 4 * 3);
+    for (std::size_t i = 0 ; i + 4 <= n ; i += 4) {
+        unsigned long c0 = base64_inv[s[i]], c1 = base64_inv[s[i + 1]];
+        unsigned long c2 = base64_inv[s[i + 2]], c3 = base64_inv[s[i + 3]];
+        if ((c0 | c1 | c2 | c3) < 64) {
+            unsigned long w = (c0 << 18) | (c1 << 12) | (c2 << 6) | c3;
+            char group[3] = {char(w >> 16), char(w >> 8), char(w)};
+            out.append(group, 3);
+            continue;
+        }
+        // Padding, or an error.  The characters are checked in the order in which the
+        // original definition looked them up.
+        if (c0 >= 64) return i;
+        if (c1 >= 64) return i + 1;
+        out += char((c0 << 2) | (c1 >> 4));
+        if (s[i + 2] != U'=') {
+            if (c2 >= 64) return i + 2;
+            out += char(((c1 & 15) << 4) | (c2 >> 2));
+        }
+        if (s[i + 3] != U'=') {
+            if (c2 >= 64) return i + 2;
+            if (c3 >= 64) return i + 3;
+            out += char(((c2 & 3) << 6) | c3);
+        }
+    }
+    return n;
+}
 
 String jsonlang_string_unescape(const LocationRange &loc, const String &s)
 {
@@ -25,6 +25,39 @@ String jsonlang_string_unparse(const String &str, bool single);
 /** Escape special characters. */
 String jsonlang_string_escape(const String &str, bool single);
 
+/** Escape special characters, appending to out.
+ *
+ * \param single Whether the string is going to be single-quoted.
+ * \param tilde Also escape ~, as std.escapeStringJson always has.
+ */
+void jsonlang_string_escape(const String &str, bool single, bool tilde, String &out);
+
+/** Escape special characters of a double-quoted string given in UTF-8, appending to out.
+ *
+ * The result is the UTF-8 encoding of what jsonlang_string_escape(str, false, false, out)
+ * would give for the decoded string.
+ */
+void jsonlang_string_escape_utf8(const char *str, std::size_t len, std::string &out);
+
+/** Escape ' for a single-quoted Bash string, appending to out. */
+void jsonlang_string_escape_bash(const String &str, String &out);
+
+/** Escape $ as $$, appending to out. */
+void jsonlang_string_escape_dollars(const String &str, String &out);
+
+/** Base64 encode the bytes, appending to out. */
+void jsonlang_base64_encode(const std::string &bytes, String &out);
+
+/** Base64 decode str, whose length must be a multiple of 4, appending the bytes to out.
+ *
+ * As in the original std.base64DecodeBytes, a group ending in = or == is padding wherever it
+ * occurs, not only at the end.
+ *
+ * \returns The index of the first character that is not valid where it occurs, or
+ * str.length() if there is none.
+ */
+std::size_t jsonlang_base64_decode(const String &str, std::string &out);
+
 /** Resolve escape chracters in the string. */
 String jsonlang_string_unescape(const LocationRange &loc, const String &s);
 
@@ -143,6 +143,38 @@ static inline String decode_utf8(const std::string &s)
     return r;
 }
 
+/** Whether encode_utf8(decode_utf8(..)) gives back exactly these bytes.
+ *
+ * That is so of well-formed UTF-8 without overlong forms, except for the codepoints from
+ * U+40000 up, which decode_utf8 does not decode correctly.  There must be no NUL in the bytes.
+ */
+static inline bool utf8_round_trips(const char *s, size_t n)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(s);
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c0 = p[i];
+        if (c0 < 0x80) continue;
+        size_t follow;
+        if (c0 >= 0xc2 && c0 <= 0xdf) {
+            follow = 1;
+        } else if (c0 >= 0xe0 && c0 <= 0xef) {
+            if (i + 1 < n && c0 == 0xe0 && p[i + 1] < 0xa0) return false;
+            follow = 2;
+        } else if (c0 == 0xf0) {
+            if (i + 1 < n && p[i + 1] < 0x90) return false;
+            follow = 3;
+        } else {
+            return false;
+        }
+        if (n - i <= follow) return false;
+        for (size_t j = 1; j <= follow; ++j) {
+            if ((p[i + j] & 0xc0) != 0x80) return false;
+        }
+        i += follow;
+    }
+    return true;
+}
+
 /** A stringstream-like class capable of holding unicode codepoints. 
  * The C++ standard does not support std::basic_stringstream<char32_t.
  */
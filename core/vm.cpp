@@ -31,10 +31,18 @@ limitations under the License.
 */
 
 #include <cassert>
+#include <cctype>
+#include <cerrno>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 
+#include <algorithm>
+#include <deque>
 #include <memory>
+#include <new>
 #include <set>
+#include <stdexcept>
 #include <string>
 
 // lambda - b
@@ -45,6 +53,11 @@ limitations under the License.
 #include <uuid/uuid.h>
 // lambda - e
 
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "desugarer.h"
 #include "json.h"
 #include "parser.h"
@@ -66,6 +79,249 @@ std::string dir_name(const std::string &path)
     return "";
 }
 
+/** The name of the value's type as returned by std.type, for errors from native std functions.
+ */
+std::string std_type_str(const Value &v)
+{
+    return v.t == Value::DOUBLE ? "number" : type_str(v);
+}
+
+/** Append str to out in double quotes, escaped the way std.escapeStringJson always has. */
+void escape_string_json(const String &str, String &out)
+{
+    out += U'"';
+    jsonlang_string_escape(str, false, true, out);
+    out += U'"';
+}
+
+/** The output of manifestJson.  The manifestation functions of the standard library differ from
+ * the JSON output in a few details, which are kept as they were when those functions were
+ * written in Jsonlang.
+ */
+enum ManifestStyle {
+    MANIFEST_JSON,  // The JSON output and std.toString.
+    MANIFEST_JSON_EX,  // std.manifestJsonEx: strings escaped as by std.escapeStringJson.
+    MANIFEST_PYTHON,  // std.manifestPython: True, False and None, field names escaped too.
+};
+
+/** A field, or an array index if field is nullptr, on the way to the value being manifested. */
+struct ManifestPathElement {
+    const Identifier *field;
+    unsigned long index;
+};
+
+/** The state of manifestJson as it walks a value, writing to a single buffer. */
+struct ManifestState {
+    ManifestStyle style;
+
+    /** Put each element and field on its own line. */
+    bool multiline;
+
+    /** When not multiline, leave out the spaces after separators and in empty objects and
+     * arrays, i.e. minify.
+     */
+    bool compact;
+
+    /** Added to the indentation for each level, when multiline. */
+    String indent;
+
+    /** The indentation of the current level. */
+    String cindent;
+
+    /** MANIFEST_JSON_EX: Where we are in the value, for errors. */
+    std::vector<ManifestPathElement> path;
+
+    /** The text so far, or since it was last flushed to sink. */
+    String out;
+
+    /** If not nullptr, out is passed on to it in UTF-8 a chunk at a time.  \see manifestFlush */
+    VmOutput *sink;
+
+    /** Reused to encode each chunk. */
+    std::string utf8;
+
+    ManifestState(ManifestStyle style, bool multiline, const String &indent,
+                  const String &cindent, VmOutput *sink = nullptr)
+      : style(style), multiline(multiline), compact(false), indent(indent), cindent(cindent),
+        sink(sink)
+    { }
+};
+
+/** The number of codepoints ManifestState::out holds before it is flushed to the sink. */
+static const size_t MANIFEST_CHUNK_SIZE = 1 << 16;
+
+/** Encodes values as CBOR (RFC 7049) or MessagePack, appending to out.
+ *
+ * Numbers that are integers, and fit in 64 bits, are encoded as integers, others as 64 bit
+ * floats.  Containers have definite lengths and integers use their shortest encoding.
+ */
+struct BinaryEncoder {
+    VmOutputFormat format;
+    std::string out;
+
+    BinaryEncoder(VmOutputFormat format)
+      : format(format)
+    { }
+
+    /** The format's name, for errors. */
+    const char *name(void) const
+    {
+        return format == VM_OUTPUT_CBOR ? "CBOR" : "MessagePack";
+    }
+
+    void bigEndian(uint64_t v, unsigned bytes)
+    {
+        for (unsigned i = bytes ; i > 0 ; --i)
+            out += char((v >> (8 * (i - 1))) & 0xff);
+    }
+
+    /** A CBOR major type and its argument. */
+    void cborHead(unsigned major, uint64_t v)
+    {
+        major <<= 5;
+        if (v < 24) {
+            out += char(major | v);
+        } else if (v <= 0xff) {
+            out += char(major | 24);
+            bigEndian(v, 1);
+        } else if (v <= 0xffff) {
+            out += char(major | 25);
+            bigEndian(v, 2);
+        } else if (v <= 0xffffffff) {
+            out += char(major | 26);
+            bigEndian(v, 4);
+        } else {
+            out += char(major | 27);
+            bigEndian(v, 8);
+        }
+    }
+
+    /** A MessagePack length, with a fixed form for lengths up to fix_max. */
+    void msgpackLength(uint64_t v, unsigned char fix, uint64_t fix_max, unsigned char tag8,
+                       unsigned char tag16, unsigned char tag32)
+    {
+        if (v <= fix_max) {
+            out += char(fix | v);
+        } else if (tag8 != 0 && v <= 0xff) {
+            out += char(tag8);
+            bigEndian(v, 1);
+        } else if (v <= 0xffff) {
+            out += char(tag16);
+            bigEndian(v, 2);
+        } else {
+            out += char(tag32);
+            bigEndian(v, 4);
+        }
+    }
+
+    void null(void)
+    {
+        out += char(format == VM_OUTPUT_CBOR ? 0xf6 : 0xc0);
+    }
+
+    void boolean(bool v)
+    {
+        if (format == VM_OUTPUT_CBOR) {
+            out += char(v ? 0xf5 : 0xf4);
+        } else {
+            out += char(v ? 0xc3 : 0xc2);
+        }
+    }
+
+    void integer(int64_t v)
+    {
+        if (format == VM_OUTPUT_CBOR) {
+            if (v >= 0) {
+                cborHead(0, v);
+            } else {
+                cborHead(1, uint64_t(-(v + 1)));
+            }
+            return;
+        }
+        if (v >= 0) {
+            if (v < 0x80) {
+                out += char(v);
+            } else if (v <= 0xff) {
+                out += char(0xcc);
+                bigEndian(v, 1);
+            } else if (v <= 0xffff) {
+                out += char(0xcd);
+                bigEndian(v, 2);
+            } else if (v <= 0xffffffffLL) {
+                out += char(0xce);
+                bigEndian(v, 4);
+            } else {
+                out += char(0xcf);
+                bigEndian(v, 8);
+            }
+        } else if (v >= -32) {
+            out += char(v);
+        } else if (v >= INT8_MIN) {
+            out += char(0xd0);
+            bigEndian(uint64_t(v), 1);
+        } else if (v >= INT16_MIN) {
+            out += char(0xd1);
+            bigEndian(uint64_t(v), 2);
+        } else if (v >= INT32_MIN) {
+            out += char(0xd2);
+            bigEndian(uint64_t(v), 4);
+        } else {
+            out += char(0xd3);
+            bigEndian(uint64_t(v), 8);
+        }
+    }
+
+    void number(double v)
+    {
+        // -0 stays a float, so that its sign survives.
+        if (v == std::floor(v) && v >= -9223372036854775808.0 && v < 9223372036854775808.0
+            && !(v == 0 && std::signbit(v))) {
+            integer(int64_t(v));
+            return;
+        }
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof bits);
+        out += char(format == VM_OUTPUT_CBOR ? 0xfb : 0xcb);
+        bigEndian(bits, 8);
+    }
+
+    /** A string, given in UTF-8. */
+    void string(const char *v, size_t length)
+    {
+        if (format == VM_OUTPUT_CBOR) {
+            cborHead(3, length);
+        } else {
+            msgpackLength(length, 0xa0, 31, 0xd9, 0xda, 0xdb);
+        }
+        out.append(v, length);
+    }
+
+    void string(const std::string &v)
+    {
+        string(v.data(), v.length());
+    }
+
+    /** The start of an array of the given number of elements, which follow. */
+    void array(uint64_t size)
+    {
+        if (format == VM_OUTPUT_CBOR) {
+            cborHead(4, size);
+        } else {
+            msgpackLength(size, 0x90, 15, 0, 0xdc, 0xdd);
+        }
+    }
+
+    /** The start of a map of the given number of pairs, whose keys and values follow. */
+    void map(uint64_t size)
+    {
+        if (format == VM_OUTPUT_CBOR) {
+            cborHead(5, size);
+        } else {
+            msgpackLength(size, 0x80, 15, 0, 0xde, 0xdf);
+        }
+    }
+};
+
 /** Stack frames.
  *
  * Of these, FRAME_CALL is the most special, as it is the only frame the stack
@@ -76,14 +332,24 @@ enum FrameKind {
     FRAME_BINARY_LEFT,  // a in a + b
     FRAME_BINARY_RIGHT,  // b in a + b
     FRAME_BUILTIN_FILTER,  // When executing std.filter, used to hold intermediate state.
+    FRAME_BUILTIN_FILTER_MAP,  // Likewise for std.filterMap.
+    FRAME_BUILTIN_FLATTEN_ARRAYS,  // Forces the arrays of std.flattenArrays one at a time.
+    FRAME_BUILTIN_FOLDL,  // Holds the running value while std.foldl calls the function.
+    FRAME_BUILTIN_FOLDR,  // Likewise for std.foldr.
     FRAME_BUILTIN_FORCE_THUNKS,  // When forcing builtin args, holds intermediate state.
+    FRAME_BUILTIN_JOIN,  // Forces the elements of std.join one at a time, joining them.
     FRAME_CALL,  // Used any time we have switched location in user code.
+    FRAME_EQUALS,  // Compares val and val2 in a == b, one element or field at a time.
+    FRAME_EQUALS_LEFT,  // The FRAME_EQUALS is evaluating the next element / field of val.
+    FRAME_EQUALS_RIGHT,  // Holds that element in val while the one of val2 is evaluated.
     FRAME_ERROR,  // e in error e
     FRAME_IF,  // e in if e then a else b
     FRAME_INDEX_TARGET,  // e in e[x]
     FRAME_INDEX_INDEX,  // e in x[e]
     FRAME_INVARIANTS,  // Caches the thunks that need to be executed one at a time.
-    FRAME_LOCAL,  // Stores thunk bindings as we execute e in local ...; e
+    FRAME_LOCAL,  // Stores the environment as we execute e in local ...; e
+    FRAME_MEMO_CALL,  // When calling a memoized function, forces the args to make the key.
+    FRAME_MEMO_RESULT,  // Caches the result of a memoized function once the body returns.
     FRAME_OBJECT,  // Stores intermediate state as we execute es in { [e]: ..., [e]: ... }
     FRAME_OBJECT_COMP_ARRAY,  // e in {f:a for x in e]
     FRAME_OBJECT_COMP_ELEMENT,  // Stores intermediate state when building object
@@ -92,14 +358,98 @@ enum FrameKind {
     FRAME_UNARY,  // e in -e
 };
 
+/** Intermediate state needed by only some kinds of stack frame.
+ *
+ * Most frames (e.g. FRAME_IF, FRAME_UNARY, FRAME_BINARY_LEFT) just remember an AST and a value
+ * or two, so the containers below are kept out of line and only attached to the frames that
+ * need them.  The Stack recycles them, so pushing such a frame does not reallocate the
+ * containers either.
+ */
+struct FrameExtra {
+
+    /** FRAME_OBJECT: The field whose name is being computed. */
+    DesugaredObject::Fields::const_iterator fit;
+
+    /** FRAME_OBJECT: The fields whose names have been computed so far. */
+    std::map<const Identifier *, HeapSimpleObject::Field> objectFields;
+
+    /** FRAME_OBJECT_COMP_ELEMENT: The fields created so far. */
+    std::map<const Identifier *, HeapThunk*> elements;
+
+    /** Thunks that are being built up or forced one at a time, e.g. function arguments,
+     * tailstrict arguments, invariants, the result of std.filter and the running value of
+     * std.foldl.
+     */
+    std::vector<HeapThunk*> thunks;
+
+    /** FRAME_MEMO_RESULT: The key under which to cache the result. */
+    std::string memoKey;
+
+    /** FRAME_EQUALS: The visible fields of the objects being compared, sorted by name. */
+    std::vector<const Identifier*> fields;
+
+    /** FRAME_BUILTIN_JOIN: The result so far, if it is a string.  Otherwise it is the array of
+     * thunks.
+     */
+    String str;
+    bool joinString;
+
+    /** FRAME_BUILTIN_JOIN: Whether no element has been joined yet. */
+    bool joinFirst;
+
+    /** Prepare for reuse by another frame, keeping the allocated capacity. */
+    void clear(void)
+    {
+        objectFields.clear();
+        elements.clear();
+        thunks.clear();
+        memoKey.clear();
+        fields.clear();
+        str.clear();
+    }
+
+    /** Mark everything visible from this state. */
+    void mark(Heap &heap) const
+    {
+        for (const auto &el : elements)
+            heap.markFrom(el.second);
+        for (const auto &th : thunks)
+            heap.markFrom(th);
+    }
+};
+
+/** Whether frames of this kind always need a FrameExtra. */
+static bool frame_kind_needs_extra(FrameKind kind)
+{
+    switch (kind) {
+        case FRAME_APPLY_TARGET:
+        case FRAME_BUILTIN_FILTER:
+        case FRAME_BUILTIN_FILTER_MAP:
+        case FRAME_BUILTIN_FLATTEN_ARRAYS:
+        case FRAME_BUILTIN_FOLDL:
+        case FRAME_BUILTIN_FOLDR:
+        case FRAME_BUILTIN_FORCE_THUNKS:
+        case FRAME_BUILTIN_JOIN:
+        case FRAME_INVARIANTS:
+        case FRAME_MEMO_RESULT:
+        case FRAME_OBJECT:
+        case FRAME_OBJECT_COMP_ARRAY:
+        return true;
+
+        default:
+        return false;
+    }
+}
+
 /** A frame on the stack.
  *
  * Every time a subterm is evaluated, we first push a new stack frame to
  * store the continuation.
  *
- * The stack frame is a bit like a tagged union, except not as memory
- * efficient.  The set of member variables that are actually used depends on
- * the value of the member varaible kind.
+ * The stack frame is a bit like a tagged union.  The set of member variables
+ * that are actually used depends on the value of the member varaible kind.
+ * The bulky state that only a few kinds need lives in a FrameExtra, which is
+ * nullptr for the other kinds.
  *
  * If the stack frame is of kind FRAME_CALL, then it counts towards the
  * maximum number of stack frames allowed.  Other stack frames are not
@@ -116,6 +466,12 @@ struct Frame {
     /** Tag (tagged union). */
     FrameKind kind;
 
+    /** Reuse this stack frame for the purpose of tail call optimization. */
+    bool tailCall;
+
+    /** Used for a variety of purposes. */
+    unsigned elementId;
+
     /** The code we were executing before. */
     const AST *ast;
 
@@ -125,29 +481,14 @@ struct Frame {
      */
     LocationRange location;
 
-    /** Reuse this stack frame for the purpose of tail call optimization. */
-    bool tailCall;
-
     /** Used for a variety of purposes. */
     Value val;
 
     /** Used for a variety of purposes. */
     Value val2;
 
-    /** Used for a variety of purposes. */
-    DesugaredObject::Fields::const_iterator fit;
-
-    /** Used for a variety of purposes. */
-    std::map<const Identifier *, HeapSimpleObject::Field> objectFields;
-
-    /** Used for a variety of purposes. */
-    unsigned elementId;
-
-    /** Used for a variety of purposes. */
-    std::map<const Identifier *, HeapThunk*> elements;
-
-    /** Used for a variety of purposes. */
-    std::vector<HeapThunk*> thunks;
+    /** Kind-specific state, or nullptr.  Owned by the Stack. */
+    FrameExtra *extra;
 
     /** The context is used in error messages to attempt to find a reasonable name for the
      * object, function, or thunk value being executed.
@@ -171,20 +512,24 @@ struct Frame {
      */
     unsigned offset;
 
-    /** A set of variables introduced at this point. */
-    BindingFrame bindings;
+    /** The environment introduced at this point, or nullptr.
+     *
+     * For FRAME_CALL this is the whole environment of the code being executed.  Otherwise it
+     * extends the environment of the frames below it.
+     */
+    HeapEnv *env;
 
     Frame(const FrameKind &kind, const AST *ast)
-      : kind(kind), ast(ast), location(ast->location), tailCall(false), elementId(0),
-        context(NULL), self(NULL), offset(0)
+      : kind(kind), tailCall(false), elementId(0), ast(ast), location(ast->location),
+        extra(nullptr), context(NULL), self(NULL), offset(0), env(nullptr)
     {
         val.t = Value::NULL_TYPE;
         val2.t = Value::NULL_TYPE;
     }
 
     Frame(const FrameKind &kind, const LocationRange &location)
-      : kind(kind), ast(nullptr), location(location), tailCall(false), elementId(0),
-        context(NULL), self(NULL), offset(0)
+      : kind(kind), tailCall(false), elementId(0), ast(nullptr), location(location),
+        extra(nullptr), context(NULL), self(NULL), offset(0), env(nullptr)
     {
         val.t = Value::NULL_TYPE;
         val2.t = Value::NULL_TYPE;
@@ -197,12 +542,14 @@ struct Frame {
         heap.markFrom(val2);
         if (context) heap.markFrom(context);
         if (self) heap.markFrom(self);
-        for (const auto &bind : bindings)
-            heap.markFrom(bind.second);
-        for (const auto &el : elements)
-            heap.markFrom(el.second);
-        for (const auto &th : thunks)
-            heap.markFrom(th);
+        if (env) heap.markFrom(env);
+        if (extra) extra->mark(heap);
+    }
+
+    /** The number of thunks held in the extra state, if any. */
+    unsigned numThunks(void) const
+    {
+        return extra == nullptr ? 0 : extra->thunks.size();
     }
 
     bool isCall(void) const
@@ -224,6 +571,25 @@ class Stack {
     /** The stack frames. */
     std::vector<Frame> stack;
 
+    /** FrameExtras released by popped frames, kept for reuse. */
+    std::vector<FrameExtra*> spareExtras;
+
+    /** Return the frame's FrameExtra (if any) to the pool. */
+    void releaseExtra(Frame &f)
+    {
+        if (f.extra == nullptr) return;
+        f.extra->clear();
+        spareExtras.push_back(f.extra);
+        f.extra = nullptr;
+    }
+
+    /** Remove the top frame. */
+    void popBack(void)
+    {
+        releaseExtra(stack.back());
+        stack.pop_back();
+    }
+
     public:
 
     Stack(unsigned limit)
@@ -231,27 +597,37 @@ class Stack {
     {
     }
 
-    ~Stack(void) { }
+    ~Stack(void)
+    {
+        for (auto &f : stack)
+            delete f.extra;
+        for (auto *extra : spareExtras)
+            delete extra;
+    }
 
     unsigned size(void)
     {
         return stack.size();
     }
 
-    /** Search for the closest variable in scope that matches the given name. */
-    HeapThunk *lookUpVar(const Identifier *id)
+    /** The environment of the code currently being executed, i.e. the one introduced by the
+     * closest frame that has one, not looking past the closest call frame.
+     */
+    HeapEnv *currentEnv(void)
     {
         for (int i=stack.size()-1 ; i>=0 ; --i) {
-            const auto &binds = stack[i].bindings;
-            auto it = binds.find(id);
-            if (it != binds.end()) {
-                return it->second;
-            }
-            if (stack[i].isCall()) break;
+            if (stack[i].env != nullptr || stack[i].isCall()) return stack[i].env;
         }
         return nullptr;
     }
 
+    /** Search for the closest variable in scope that matches the given name. */
+    HeapThunk *lookUpVar(const Identifier *id)
+    {
+        HeapEnv *env = currentEnv();
+        return env == nullptr ? nullptr : env->lookUp(id);
+    }
+
     /** Mark everything visible from the stack (any frame). */
     void mark(Heap &heap)
     {
@@ -273,7 +649,21 @@ class Stack {
     void pop(void)
     {
         if (top().isCall()) calls--;
-        stack.pop_back();
+        popBack();
+    }
+
+    /** Give the frame a FrameExtra, if it does not already have one. */
+    FrameExtra &attachExtra(Frame &f)
+    {
+        if (f.extra == nullptr) {
+            if (spareExtras.size() > 0) {
+                f.extra = spareExtras.back();
+                spareExtras.pop_back();
+            } else {
+                f.extra = new FrameExtra();
+            }
+        }
+        return *f.extra;
     }
 
     /** Attempt to find a name for a given heap entity.  This may not be possible, but we try
@@ -284,17 +674,23 @@ class Stack {
     std::string getName(unsigned from_here, const HeapEntity *e)
     {
         std::string name;
+        HeapEnv *env = nullptr;
         for (int i=from_here-1 ; i>=0; --i) {
             const auto &f = stack[i];
-            for (const auto &pair : f.bindings) {
+            if (f.env != nullptr || f.isCall()) {
+                env = f.env;
+                break;
+            }
+        }
+        // Do not go past the environment of the enclosing call frame, keep local reasoning.
+        for ( ; env != nullptr && name == "" ; env = env->parent) {
+            for (const auto &pair : env->bindings) {
                 HeapThunk *thunk = pair.second;
                 if (!thunk->filled) continue;
                 if (!thunk->content.isHeap()) continue;
                 if (e != thunk->content.v.h) continue;
                 name = encode_utf8(pair.first->name);
             }
-            // Do not go into the next call frame, keep local reasoning.
-            if (f.isCall()) break;
         }
 
         if (name == "") name = "anonymous";
@@ -354,6 +750,7 @@ class Stack {
     template <class... Args> void newFrame(Args... args)
     {
         stack.emplace_back(args...);
+        if (frame_kind_needs_extra(top().kind)) attachExtra(top());
     }
 
     /** If there is a tailstrict annotated frame followed by some locals, pop them all. */
@@ -362,11 +759,11 @@ class Stack {
         for (int i=stack.size()-1 ; i>=0 ; --i) {
             switch (stack[i].kind) {
                 case FRAME_CALL: {
-                    if (!stack[i].tailCall || stack[i].thunks.size() > 0) {
+                    if (!stack[i].tailCall || stack[i].numThunks() > 0) {
                         return;
                     }
                     // Remove all stack frames including this one.
-                    while (stack.size() > unsigned(i)) stack.pop_back();
+                    while (stack.size() > unsigned(i)) popBack();
                     calls--;
                     return;
                 } break;
@@ -380,7 +777,7 @@ class Stack {
 
     /** New call frame. */
     void newCall(const LocationRange &loc, HeapEntity *context, HeapObject *self,
-                 unsigned offset, const BindingFrame &up_values)
+                 unsigned offset, HeapEnv *up_values)
     {
         tailCallTrimStack();
         if (calls >= limit) {
@@ -391,18 +788,8 @@ class Stack {
         top().context = context;
         top().self = self;
         top().offset = offset;
-        top().bindings = up_values;
+        top().env = up_values;
         top().tailCall = false;
-
-        #ifndef NDEBUG
-        for (const auto &bind : up_values) {
-            if (bind.second == nullptr) {
-                std::cerr << "INTERNAL ERROR: No binding for variable "
-                          << encode_utf8(bind.first->name) << std::endl;
-                std::abort();
-            }
-        }
-        #endif
     }
 
     /** Look up the stack to find the self binding. */
@@ -437,6 +824,119 @@ typedef std::map<std::string, VmExt> ExtMap;
 /** Typedef to save some typing. */
 typedef std::map<std::string, std::string> StrMap;
 
+/** Collects one file of multi mode in a worker process of --jobs, to be sent to the parent. */
+struct WorkerDocument : public VmOutput {
+    /** Whether beginDocument was reached, i.e. the value of the field was evaluated. */
+    bool begun;
+    std::string content;
+    WorkerDocument(void)
+      : begun(false)
+    { }
+    void beginDocument(const char *name)
+    {
+        (void) name;
+        begun = true;
+    }
+    void write(const char *data, size_t len)
+    {
+        content.append(data, len);
+    }
+};
+
+/** What a record from a worker process of --jobs holds.  \see Interpreter::manifestMultiWorker */
+enum WorkerRecordKind {
+    RECORD_FILE,
+    RECORD_RUNTIME_ERROR,
+    RECORD_STATIC_ERROR,
+    RECORD_OUT_OF_MEMORY,
+    RECORD_EXCEPTION
+};
+
+/** Records passed from worker to parent process are encoded with these.  Both ends are the
+ * same binary on the same machine, so integers are simply in native byte order.
+ */
+void record_put(std::string &buf, uint64_t v)
+{
+    buf.append(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+void record_put(std::string &buf, const std::string &s)
+{
+    record_put(buf, uint64_t(s.length()));
+    buf += s;
+}
+
+/** Decodes a record made with record_put. */
+struct RecordReader {
+    const std::string &buf;
+    size_t pos;
+    RecordReader(const std::string &buf)
+      : buf(buf), pos(0)
+    { }
+    uint64_t u64(void)
+    {
+        uint64_t v;
+        assert(pos + sizeof v <= buf.length());
+        memcpy(&v, buf.data() + pos, sizeof v);
+        pos += sizeof v;
+        return v;
+    }
+    std::string str(void)
+    {
+        size_t len = u64();
+        assert(pos + len <= buf.length());
+        std::string r = buf.substr(pos, len);
+        pos += len;
+        return r;
+    }
+};
+
+/** Write all of buf to fd, a pipe.  \returns false on error. */
+bool write_all(int fd, const std::string &buf)
+{
+    size_t done = 0;
+    while (done < buf.length()) {
+        ssize_t r = ::write(fd, buf.data() + done, buf.length() - done);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += r;
+    }
+    return true;
+}
+
+/** The worker processes of --jobs, each with the read end of a pipe.
+ *
+ * Workers still running when this is destroyed, e.g. because the parent is unwinding from an
+ * error, are killed.
+ */
+struct WorkerProcesses {
+    std::vector<pid_t> pids;
+    std::vector<int> fds;
+    ~WorkerProcesses(void)
+    {
+        closeAll();
+        for (pid_t pid : pids)
+            kill(pid, SIGKILL);
+        waitAll();
+    }
+    void closeAll(void)
+    {
+        for (int &fd : fds) {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+    }
+    void waitAll(void)
+    {
+        for (pid_t pid : pids) {
+            while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR) { }
+        }
+        pids.clear();
+    }
+};
+
 
 class Interpreter;
 
@@ -480,14 +980,40 @@ class Interpreter {
     /** Used to refer to idJsonObjVar. */
     const AST *jsonObjVar;
 
+    /** Evaluated to run frames pushed by native code, e.g. in equals. */
+    const AST *nullLiteral;
+
+    /** Used to "name" the function and element bound in the thunks created by std.map. */
+    const Identifier *idMapFunc;
+    const Identifier *idMapElement;
+
+    /** The call made by those thunks when the function cannot simply be inlined. */
+    const AST *mapApply;
+
+    /** Used to "name" the target and patch bound in the thunks created by std.mergePatch. */
+    const Identifier *idMergeTarget;
+    const Identifier *idMergePatch;
+
+    /** The recursive call made by those thunks, with the function bound to idMapFunc. */
+    const AST *mergePatchApply;
+
     struct ImportCacheValue {
         std::string foundHere;
-        std::string content;
+        std::shared_ptr<const FileSource> content;
+        /** Whether importJson has found the content to be JSON, and if so its value. */
+        enum { JSON_UNKNOWN, JSON_YES, JSON_NO } isJson = JSON_UNKNOWN;
+        Value json;
     };
 
     /** Cache for imported Jsonlang files. */
-    std::map<std::pair<std::string, String>,
-             const ImportCacheValue *> cachedImports;
+    std::map<std::pair<std::string, String>, ImportCacheValue *> cachedImports;
+
+    /** Strings shared by every evaluation of a string literal with the same value.
+     *
+     * These are never collected.  Only strings that appear in the program text (or are
+     * otherwise bounded, e.g. the results of std.type) are interned.
+     */
+    std::map<String, HeapString*> internedStrings;
 
     /** External variables for std.extVar. */
     ExtMap externalVars;
@@ -501,6 +1027,9 @@ class Interpreter {
     /** User context pointer for the import callback. */
     void *importCallbackContext;
 
+    /** If not null, used instead of importCallback, to keep the files without copying them. */
+    VmImportLoader *importLoader;
+
     /** Builtin functions by name. */
     typedef std::map<std::string, BuiltinFunc> BuiltinMap;
     BuiltinMap builtins;
@@ -527,6 +1056,16 @@ class Interpreter {
             // Mark from the scratch register
             heap.markFrom(scratch);
 
+            // Mark the interned strings.
+            for (const auto &pair : internedStrings)
+                heap.markFrom(pair.second);
+
+            // Mark the values of imported JSON files.
+            for (const auto &pair : cachedImports) {
+                if (pair.second != nullptr && pair.second->isJson == ImportCacheValue::JSON_YES)
+                    heap.markFrom(pair.second->json);
+            }
+
             // Delete unreachable objects.
             heap.sweep();
         }
@@ -575,11 +1114,11 @@ class Interpreter {
         return r;
     }
 
-    Value makeClosure(const BindingFrame &env,
+    Value makeClosure(HeapEnv *env,
                        HeapObject *self,
                        unsigned offset,
                        const HeapClosure::Params &params,
-                       AST *body)
+                       const AST *body)
     {
         Value r;
         r.t = Value::FUNCTION;
@@ -601,7 +1140,7 @@ class Interpreter {
         AST *body = nullptr;
         Value r;
         r.t = Value::FUNCTION;
-        r.v.h = makeHeap<HeapClosure>(BindingFrame(), nullptr, 0, params, body, name);
+        r.v.h = makeHeap<HeapClosure>(nullptr, nullptr, 0, params, body, name);
         return r;
     }
 
@@ -621,6 +1160,34 @@ class Interpreter {
         return r;
     }
 
+    /** A string whose value is the first length bytes of the file, not yet decoded. */
+    Value makeString(const std::shared_ptr<const FileSource> &utf8, size_t length)
+    {
+        Value r;
+        r.t = Value::STRING;
+        r.v.h = makeHeap<HeapString>(utf8, length);
+        return r;
+    }
+
+    /** Like makeString, but returns the same HeapString every time for the same value.
+     *
+     * Equality of interned strings is usually decided by comparing pointers.
+     */
+    Value makeInternedString(const String &v)
+    {
+        Value r;
+        r.t = Value::STRING;
+        auto it = internedStrings.find(v);
+        if (it != internedStrings.end()) {
+            r.v.h = it->second;
+        } else {
+            auto *str = makeHeap<HeapString>(v);
+            internedStrings[v] = str;
+            r.v.h = str;
+        }
+        return r;
+    }
+
     /** Auxiliary function of objectIndex.
      *
      * Traverse the object's tree from right to left, looking for an object
@@ -658,36 +1225,55 @@ class Interpreter {
         return nullptr;
     }
 
-    typedef std::map<const Identifier*, ObjectField::Hide> IdHideMap;
-
-    /** Auxiliary function.
+    /** The fields of obj, built and cached in obj the first time they are needed.
+     *
+     * Only obj itself caches its index.  The levels of an extended object are walked without
+     * caching theirs (though an index they already have is used), because each level keeps
+     * its left side alive, so caching every level of a chain of n + would hold O(n^2) entries.
      */
-    IdHideMap objectFieldsAux(const HeapObject *obj_)
+    const ObjectFieldIndex &objectFieldIndex(const HeapObject *obj_)
     {
-        IdHideMap r;
-        if (auto *obj = dynamic_cast<const HeapSimpleObject*>(obj_)) {
-            for (const auto &f : obj->fields) {
-                r[f.first] = f.second.hide;
+        if (obj_->fieldIndex != nullptr) return *obj_->fieldIndex;
+        std::unique_ptr<ObjectFieldIndex> r(new ObjectFieldIndex());
+        auto &hide = r->hide;
+        auto add = [&hide](const Identifier *f, ObjectField::Hide h) {
+            auto it = hide.find(f);
+            if (it == hide.end()) {
+                // First time it is seen
+                hide[f] = h;
+            } else if (it->second == ObjectField::INHERIT) {
+                // Seen before, but with inherited visibility so use new visibility
+                it->second = h;
             }
-
-        } else if (auto *obj = dynamic_cast<const HeapExtendedObject*>(obj_)) {
-            r = objectFieldsAux(obj->right);
-            for (const auto &pair : objectFieldsAux(obj->left)) {
-                auto it = r.find(pair.first);
-                if (it == r.end()) {
-                    // First time it is seen
-                    r[pair.first] = pair.second;
-                } else if (it->second == ObjectField::INHERIT) {
-                    // Seen before, but with inherited visibility so use new visibility
-                    r[pair.first] = pair.second;
-                }
+        };
+        // Visit the leaves from right to left, so the rightmost visibility that is not
+        // INHERIT wins.  A stack rather than recursion, as chains can be very long.
+        std::vector<const HeapObject*> todo = {obj_};
+        while (!todo.empty()) {
+            const HeapObject *curr = todo.back();
+            todo.pop_back();
+            if (curr != obj_ && curr->fieldIndex != nullptr) {
+                for (const auto &pair : curr->fieldIndex->hide)
+                    add(pair.first, pair.second);
+
+            } else if (auto *obj = dynamic_cast<const HeapSimpleObject*>(curr)) {
+                for (const auto &f : obj->fields)
+                    add(f.first, f.second.hide);
+
+            } else if (auto *obj = dynamic_cast<const HeapExtendedObject*>(curr)) {
+                todo.push_back(obj->left);
+                todo.push_back(obj->right);
+
+            } else if (auto *obj = dynamic_cast<const HeapComprehensionObject*>(curr)) {
+                for (const auto &f : obj->compValues)
+                    add(f.first, obj->hide);
             }
-
-        } else if (auto *obj = dynamic_cast<const HeapComprehensionObject*>(obj_)) {
-            for (const auto &f : obj->compValues)
-                r[f.first] = ObjectField::VISIBLE;
         }
-        return r;
+        for (const auto &pair : hide) {
+            if (pair.second != ObjectField::HIDDEN) r->numVisible++;
+        }
+        obj_->fieldIndex = std::move(r);
+        return *obj_->fieldIndex;
     }
 
     /** Auxiliary function.
@@ -695,7 +1281,7 @@ class Interpreter {
     std::set<const Identifier*> objectFields(const HeapObject *obj_, bool manifesting)
     {
         std::set<const Identifier*> r;
-        for (const auto &pair : objectFieldsAux(obj_)) {
+        for (const auto &pair : objectFieldIndex(obj_).hide) {
             if (!manifesting || pair.second != ObjectField::HIDDEN) r.insert(pair.first);
         }
         return r;
@@ -927,7 +1513,7 @@ class Interpreter {
         // lambda -e
 
         const ImportCacheValue *input = importString(loc, file);
-        Tokens tokens = jsonlang_lex(input->foundHere, input->content.c_str());
+        Tokens tokens = jsonlang_lex(input->foundHere, input->content->data());
         AST *expr = jsonlang_parse(alloc, tokens);
         jsonlang_desugar(alloc, expr, nullptr);
         jsonlang_static_analysis(expr);
@@ -950,49 +1536,300 @@ class Interpreter {
      * \param file Path to the filename.
      * \param found_here If non-null, used to store the actual path of the file
      */
-    const ImportCacheValue *importString(const LocationRange &loc, const LiteralString *file)
+    ImportCacheValue *importString(const LocationRange &loc, const LiteralString *file)
     {
         std::string dir = dir_name(loc.file);
 
         const String &path = file->value;
 
         std::pair<std::string, String> key(dir, path);
-        const ImportCacheValue *cached_value = cachedImports[key];
+        ImportCacheValue *cached_value = cachedImports[key];
         if (cached_value != nullptr)
             return cached_value;
 
-        int success = 0;
-        char *found_here_cptr;
-        char *content =
-            importCallback(importCallbackContext, dir.c_str(), encode_utf8(path).c_str(),
-                           &found_here_cptr, &success);
+        auto *input_ptr = new ImportCacheValue();
+        std::unique_ptr<ImportCacheValue> input_owner(input_ptr);
+        if (importLoader != nullptr) {
+            std::string err_msg;
+            input_ptr->content = importLoader(importCallbackContext, dir, encode_utf8(path),
+                                              input_ptr->foundHere, err_msg);
+            if (input_ptr->content == nullptr) {
+                std::string msg = "Couldn't open import \"" + encode_utf8(path) + "\": ";
+                msg += err_msg;
+                throw makeError(loc, msg);
+            }
+        } else {
+            int success = 0;
+            char *found_here_cptr;
+            char *content =
+                importCallback(importCallbackContext, dir.c_str(), encode_utf8(path).c_str(),
+                               &found_here_cptr, &success);
+
+            std::string input(content);
+            ::free(content);
+
+            if (!success) {
+                std::string msg = "Couldn't open import \"" + encode_utf8(path) + "\": ";
+                msg += input;
+                throw makeError(loc, msg);
+            }
 
-        std::string input(content);
-        ::free(content);
+            input_ptr->foundHere = found_here_cptr;
+            input_ptr->content = FileSource::fromString(std::move(input));
+            ::free(found_here_cptr);
+        }
+        cachedImports[key] = input_owner.release();
+        return input_ptr;
+    }
 
-        if (!success) {
-            std::string msg = "Couldn't open import \"" + encode_utf8(path) + "\": ";
-            msg += input;
-            throw makeError(loc, msg);
+    /** Import a JSON file without the Jsonlang lexer, parser and desugarer, leaving its value in
+     * scratch.
+     *
+     * Files named *.json, and others that begin like a JSON object or array, are tried.  The
+     * value is kept with the cached file, so importing it again costs nothing.
+     *
+     * \returns false if the file is to be imported as Jsonlang code after all.
+     */
+    bool importJson(const LocationRange &loc, const LiteralString *file)
+    {
+        const std::string name = encode_utf8(file->value);
+        // As in import, other names are fetched or executed.
+        if (name.find(".json") == std::string::npos
+            && name.find(".libjsonlang") == std::string::npos)
+            return false;
+        ImportCacheValue *input = importString(loc, file);
+        if (input->isJson == ImportCacheValue::JSON_UNKNOWN) {
+            const char *text = input->content->data();
+            const char *text_end = text + input->content->size();
+            bool json_name = name.length() >= 5
+                             && name.compare(name.length() - 5, 5, ".json") == 0;
+            const char *first = text;
+            while (first != text_end && std::strchr(" \t\r\n", *first) != nullptr) first++;
+            bool json_start = first != text_end && (*first == '{' || *first == '[');
+            input->isJson = ImportCacheValue::JSON_NO;
+            if (json_name || json_start) {
+                JsonCursor j = {text, text_end, 0};
+                if (jsonParseValue(j, scratch)) {
+                    jsonSkipSpace(j);
+                    if (j.c == j.end) {
+                        input->isJson = ImportCacheValue::JSON_YES;
+                        input->json = scratch;
+                    }
+                }
+            }
         }
+        if (input->isJson != ImportCacheValue::JSON_YES) return false;
+        scratch = input->json;
+        return true;
+    }
 
-        auto *input_ptr = new ImportCacheValue();
-        input_ptr->foundHere = found_here_cptr;
-        input_ptr->content = input;
-        ::free(found_here_cptr);
-        cachedImports[key] = input_ptr;
-        return input_ptr;
+    /** The position of jsonParseValue in the text. */
+    struct JsonCursor {
+        const char *c;
+        const char *end;
+        unsigned depth;
+    };
+
+    /** Objects and arrays nested deeper than this are left to the Jsonlang parser. */
+    static const unsigned JSON_MAX_DEPTH = 1000;
+
+    void jsonSkipSpace(JsonCursor &j)
+    {
+        while (j.c != j.end && (*j.c == ' ' || *j.c == '\t' || *j.c == '\r' || *j.c == '\n'))
+            ++j.c;
+    }
+
+    /** Parse the JSON value at j into attach, which must be reachable by the garbage
+     * collector, building heap values directly as jsonToHeap does.
+     *
+     * Only strict JSON is accepted.  Anything else, including duplicate fields and numbers
+     * that overflow, returns false so that the file is imported as Jsonlang, which gives the
+     * usual errors and their locations.  Whatever is accepted has the value Jsonlang would
+     * give the same text.
+     */
+    bool jsonParseValue(JsonCursor &j, Value &attach)
+    {
+        jsonSkipSpace(j);
+        if (j.c == j.end) return false;
+        switch (*j.c) {
+            case '{': {
+                if (++j.depth > JSON_MAX_DEPTH) return false;
+                ++j.c;
+                attach = makeObject<HeapComprehensionObject>(
+                    nullptr, jsonObjVar, idJsonObjVar, BindingFrame{}, ObjectField::INHERIT);
+                auto *obj = static_cast<HeapComprehensionObject*>(attach.v.h);
+                jsonSkipSpace(j);
+                if (j.c != j.end && *j.c == '}') {
+                    ++j.c;
+                    --j.depth;
+                    return true;
+                }
+                while (true) {
+                    jsonSkipSpace(j);
+                    String name;
+                    if (!jsonParseString(j, name)) return false;
+                    jsonSkipSpace(j);
+                    if (j.c == j.end || *j.c != ':') return false;
+                    ++j.c;
+                    const Identifier *id = alloc->makeIdentifier(name);
+                    if (obj->compValues.find(id) != obj->compValues.end()) return false;
+                    auto *thunk = makeHeap<HeapThunk>(idJsonObjVar, nullptr, 0, nullptr);
+                    obj->compValues[id] = thunk;
+                    // Filled before the value is made, so the collector keeps it.
+                    thunk->content = makeNull();
+                    thunk->filled = true;
+                    if (!jsonParseValue(j, thunk->content)) return false;
+                    jsonSkipSpace(j);
+                    if (j.c == j.end) return false;
+                    if (*j.c == '}') break;
+                    if (*j.c != ',') return false;
+                    ++j.c;
+                }
+                ++j.c;
+                --j.depth;
+                return true;
+            }
+
+            case '[': {
+                if (++j.depth > JSON_MAX_DEPTH) return false;
+                ++j.c;
+                attach = makeArray(std::vector<HeapThunk*>{});
+                auto *arr = static_cast<HeapArray*>(attach.v.h);
+                jsonSkipSpace(j);
+                if (j.c != j.end && *j.c == ']') {
+                    ++j.c;
+                    --j.depth;
+                    return true;
+                }
+                while (true) {
+                    auto *thunk = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, nullptr);
+                    arr->elements.push_back(thunk);
+                    thunk->content = makeNull();
+                    thunk->filled = true;
+                    if (!jsonParseValue(j, thunk->content)) return false;
+                    jsonSkipSpace(j);
+                    if (j.c == j.end) return false;
+                    if (*j.c == ']') break;
+                    if (*j.c != ',') return false;
+                    ++j.c;
+                }
+                ++j.c;
+                --j.depth;
+                return true;
+            }
+
+            case '"': {
+                String str;
+                if (!jsonParseString(j, str)) return false;
+                attach = makeString(str);
+                return true;
+            }
+
+            case 't':
+            if (!jsonParseWord(j, "true")) return false;
+            attach = makeBoolean(true);
+            return true;
+
+            case 'f':
+            if (!jsonParseWord(j, "false")) return false;
+            attach = makeBoolean(false);
+            return true;
+
+            case 'n':
+            if (!jsonParseWord(j, "null")) return false;
+            attach = makeNull();
+            return true;
+
+            default:
+            return jsonParseNumber(j, attach);
+        }
+    }
+
+    bool jsonParseWord(JsonCursor &j, const char *word)
+    {
+        size_t len = strlen(word);
+        if (size_t(j.end - j.c) < len || memcmp(j.c, word, len) != 0) return false;
+        j.c += len;
+        return true;
+    }
+
+    /** A number, checked against the JSON grammar and then converted as by the lexer. */
+    bool jsonParseNumber(JsonCursor &j, Value &attach)
+    {
+        const char *begin = j.c;
+        auto digits = [&j]() {
+            const char *start = j.c;
+            while (j.c != j.end && *j.c >= '0' && *j.c <= '9') ++j.c;
+            return j.c != start;
+        };
+        if (j.c != j.end && *j.c == '-') ++j.c;
+        if (j.c != j.end && *j.c == '0') {
+            ++j.c;
+        } else if (!digits()) {
+            return false;
+        }
+        if (j.c != j.end && *j.c == '.') {
+            ++j.c;
+            if (!digits()) return false;
+        }
+        if (j.c != j.end && (*j.c == 'e' || *j.c == 'E')) {
+            ++j.c;
+            if (j.c != j.end && (*j.c == '+' || *j.c == '-')) ++j.c;
+            if (!digits()) return false;
+        }
+        double v = strtod(std::string(begin, j.c).c_str(), nullptr);
+        if (!std::isfinite(v)) return false;
+        attach = makeDouble(v);
+        return true;
     }
 
-    /** Capture the required variables from the environment. */
-    BindingFrame capture(const std::vector<const Identifier*> &free_vars)
+    /** A string, whose escapes are checked against the JSON grammar and then decoded by the
+     * same function as for string literals.
+     */
+    bool jsonParseString(JsonCursor &j, String &out)
     {
-        BindingFrame env;
-        for (auto fv : free_vars) {
-            auto *th = stack.lookUpVar(fv);
-            env[fv] = th;
+        if (j.c == j.end || *j.c != '"') return false;
+        const char *begin = ++j.c;
+        bool escaped = false;
+        while (true) {
+            if (j.c == j.end) return false;
+            unsigned char ch = *j.c;
+            if (ch == '"') break;
+            if (ch < 0x20) return false;
+            if (ch == '\\') {
+                escaped = true;
+                if (++j.c == j.end) return false;
+                switch (*j.c) {
+                    case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r':
+                    case 't':
+                    break;
+
+                    case 'u':
+                    for (unsigned i = 0 ; i < 4 ; ++i) {
+                        if (++j.c == j.end || !isxdigit((unsigned char)(*j.c))) return false;
+                    }
+                    break;
+
+                    default:
+                    return false;
+                }
+            }
+            ++j.c;
         }
-        return env;
+        out = decode_utf8(std::string(begin, j.c));
+        ++j.c;
+        if (escaped) out = jsonlang_string_unescape(LocationRange(), out);
+        return true;
+    }
+
+    /** Capture the environment at the current point of execution.
+     *
+     * Environments are immutable once built, so the pointer can be shared by everything that
+     * is created here.
+     */
+    HeapEnv *capture(void)
+    {
+        return stack.currentEnv();
     }
 
     /** Count the number of leaves in the tree.
@@ -1023,7 +1860,8 @@ class Interpreter {
         double gc_growth_trigger,
         const VmNativeCallbackMap &native_callbacks,
         JsonlangImportCallback *import_callback,
-        void *import_callback_context)
+        void *import_callback_context,
+        VmImportLoader *import_loader)
 
       : heap(gc_min_objects, gc_growth_trigger),
         stack(max_stack),
@@ -1032,10 +1870,29 @@ class Interpreter {
         idInvariant(alloc->makeIdentifier(U"object_assert")),
         idJsonObjVar(alloc->makeIdentifier(U"_")),
         jsonObjVar(alloc->make<Var>(LocationRange(), Fodder{}, idJsonObjVar)),
+        nullLiteral(alloc->make<LiteralNull>(LocationRange(), Fodder{})),
+        idMapFunc(alloc->makeIdentifier(U"func")),
+        idMapElement(alloc->makeIdentifier(U"x")),
+        mapApply(alloc->make<Apply>(
+            LocationRange(), Fodder{}, alloc->make<Var>(LocationRange(), Fodder{}, idMapFunc),
+            Fodder{}, ArgParams{ArgParam(alloc->make<Var>(LocationRange(), Fodder{}, idMapElement),
+                                         Fodder{})},
+            false, Fodder{}, Fodder{}, false)),
+        idMergeTarget(alloc->makeIdentifier(U"target")),
+        idMergePatch(alloc->makeIdentifier(U"patch")),
+        mergePatchApply(alloc->make<Apply>(
+            LocationRange(), Fodder{}, alloc->make<Var>(LocationRange(), Fodder{}, idMapFunc),
+            Fodder{},
+            ArgParams{ArgParam(alloc->make<Var>(LocationRange(), Fodder{}, idMergeTarget),
+                               Fodder{}),
+                      ArgParam(alloc->make<Var>(LocationRange(), Fodder{}, idMergePatch),
+                               Fodder{})},
+            false, Fodder{}, Fodder{}, false)),
         externalVars(ext_vars),
         nativeCallbacks(native_callbacks),
         importCallback(import_callback),
-        importCallbackContext(import_callback_context)
+        importCallbackContext(import_callback_context),
+        importLoader(import_loader)
     {
         scratch = makeNull();
         builtins["makeArray"] = &Interpreter::builtinMakeArray;
@@ -1064,6 +1921,44 @@ class Interpreter {
         builtins["extVar"] = &Interpreter::builtinExtVar;
         builtins["primitiveEquals"] = &Interpreter::builtinPrimitiveEquals;
         builtins["native"] = &Interpreter::builtinNative;
+        builtins["memoize"] = &Interpreter::builtinMemoize;
+        builtins["memoizeStats"] = &Interpreter::builtinMemoizeStats;
+        builtins["substr"] = &Interpreter::builtinSubstr;
+        builtins["startsWith"] = &Interpreter::builtinStartsWith;
+        builtins["endsWith"] = &Interpreter::builtinEndsWith;
+        builtins["stringChars"] = &Interpreter::builtinStringChars;
+        builtins["split"] = &Interpreter::builtinSplit;
+        builtins["splitLimit"] = &Interpreter::builtinSplitLimit;
+        builtins["join"] = &Interpreter::builtinJoin;
+        builtins["format"] = &Interpreter::builtinFormat;
+        builtins["mod"] = &Interpreter::builtinMod;
+        builtins["sort"] = &Interpreter::builtinSort;
+        builtins["uniq"] = &Interpreter::builtinUniq;
+        builtins["set"] = &Interpreter::builtinSet;
+        builtins["setMember"] = &Interpreter::builtinSetMember;
+        builtins["setUnion"] = &Interpreter::builtinSetUnion;
+        builtins["setInter"] = &Interpreter::builtinSetInter;
+        builtins["setDiff"] = &Interpreter::builtinSetDiff;
+        builtins["foldl"] = &Interpreter::builtinFoldl;
+        builtins["foldr"] = &Interpreter::builtinFoldr;
+        builtins["map"] = &Interpreter::builtinMap;
+        builtins["filterMap"] = &Interpreter::builtinFilterMap;
+        builtins["flattenArrays"] = &Interpreter::builtinFlattenArrays;
+        builtins["escapeStringJson"] = &Interpreter::builtinEscapeStringJson;
+        builtins["escapeStringBash"] = &Interpreter::builtinEscapeStringBash;
+        builtins["escapeStringDollars"] = &Interpreter::builtinEscapeStringDollars;
+        builtins["manifestJsonEx"] = &Interpreter::builtinManifestJsonEx;
+        builtins["manifestYamlStream"] = &Interpreter::builtinManifestYamlStream;
+        builtins["manifestIni"] = &Interpreter::builtinManifestIni;
+        builtins["manifestPython"] = &Interpreter::builtinManifestPython;
+        builtins["manifestPythonVars"] = &Interpreter::builtinManifestPythonVars;
+        builtins["base64"] = &Interpreter::builtinBase64;
+        builtins["base64DecodeBytes"] = &Interpreter::builtinBase64DecodeBytes;
+        builtins["base64Decode"] = &Interpreter::builtinBase64Decode;
+        builtins["mergePatch"] = &Interpreter::builtinMergePatch;
+        builtins["parseInt"] = &Interpreter::builtinParseInt;
+        builtins["parseOctal"] = &Interpreter::builtinParseOctal;
+        builtins["parseHex"] = &Interpreter::builtinParseHex;
     }
 
     /** Clean up the heap, stack, stash, and builtin function ASTs. */
@@ -1137,12 +2032,13 @@ class Interpreter {
         for (long i=0 ; i<sz ; ++i) {
             auto *th = makeHeap<HeapThunk>(idArrayElement, func->self, func->offset, func->body);
             // The next line stops the new thunks from being GCed.
-            f.thunks.push_back(th);
-            th->upValues = func->upValues;
+            f.extra->thunks.push_back(th);
 
             auto *el = makeHeap<HeapThunk>(func->params[0].id, nullptr, 0, nullptr);
             el->fill(makeDouble(i));  // i guaranteed not to be inf/NaN
-            th->upValues[func->params[0].id] = el;
+            f.extra->thunks.push_back(el);
+            th->upValues = makeHeap<HeapEnv>(func->upValues,
+                                             BindingFrame{{func->params[0].id, el}});
             elements[i] = th;
         }
         scratch = makeArray(elements);
@@ -1223,167 +2119,1667 @@ class Interpreter {
     {
         switch (args[0].t) {
             case Value::NULL_TYPE:
-            scratch = makeString(U"null");
+            scratch = makeInternedString(U"null");
             return nullptr;
 
             case Value::BOOLEAN:
-            scratch = makeString(U"boolean");
+            scratch = makeInternedString(U"boolean");
             return nullptr;
 
             case Value::DOUBLE:
-            scratch = makeString(U"number");
+            scratch = makeInternedString(U"number");
+            return nullptr;
+
+            case Value::ARRAY:
+            scratch = makeInternedString(U"array");
+            return nullptr;
+
+            case Value::FUNCTION:
+            scratch = makeInternedString(U"function");
+            return nullptr;
+
+            case Value::OBJECT:
+            scratch = makeInternedString(U"object");
+            return nullptr;
+
+            case Value::STRING:
+            scratch = makeInternedString(U"string");
+            return nullptr;
+        }
+        return nullptr;  // Quiet, compiler.
+    }
+
+    /** Push the frames that call a function from native code, the way FRAME_APPLY_TARGET
+     * would for a call with the given positional arguments.
+     *
+     * The arguments must be kept alive by the calling frame.
+     *
+     * \param ast The call to the native function, used for errors and stack traces.
+     * \returns The AST to evaluate next.  When the stack is back to the calling frame, the
+     * result of the call is in scratch.
+     */
+    const AST *callFunction(const Apply &ast, Value func_val, const std::vector<HeapThunk*> &args)
+    {
+        auto *func = static_cast<HeapClosure*>(func_val.v.h);
+        if (args.size() > func->params.size()) {
+            std::stringstream ss;
+            ss << "Too many args, function has " << func->params.size() << " parameter(s)";
+            throw makeError(ast.location, ss.str());
+        }
+        BindingFrame bindings;
+        for (unsigned i = 0 ; i < func->params.size() ; ++i) {
+            const auto &param = func->params[i];
+            if (i < args.size()) {
+                bindings[param.id] = args[i];
+            } else if (param.def == nullptr) {
+                std::stringstream ss;
+                ss << "Function parameter " << encode_utf8(param.id->name) <<
+                      " not bound in call.";
+                throw makeError(ast.location, ss.str());
+            }
+        }
+
+        if (func->body == nullptr) {
+            // Built-in function, these never have default arguments.
+            stack.newFrame(FRAME_BUILTIN_FORCE_THUNKS, &ast);
+            stack.top().extra->thunks = args;
+            stack.top().val = func_val;
+            return nullLiteral;
+        }
+
+        auto *up_values = makeHeap<HeapEnv>(func->upValues, bindings);
+        if (func->memo != nullptr) {
+            stack.newFrame(FRAME_MEMO_CALL, &ast);
+            stack.top().val = func_val;
+            stack.top().env = up_values;
+        } else {
+            stack.newCall(ast.location, func, func->self, func->offset, up_values);
+        }
+        // Now that the new frame keeps the environment alive, bind the default arguments.
+        for (unsigned i = args.size() ; i < func->params.size() ; ++i) {
+            const auto &param = func->params[i];
+            auto *thunk = makeHeap<HeapThunk>(param.id, func->self, func->offset, param.def);
+            thunk->upValues = up_values;
+            up_values->bindings[param.id] = thunk;
+        }
+        return func->memo != nullptr ? nullLiteral : func->body;
+    }
+
+    /** Replace each element of arr by a thunk that applies a function to it on demand.
+     *
+     * The array and the thunk fn, which holds the function, must be kept alive by the caller.
+     * A plain function of one parameter is inlined into the thunks, anything else (builtins,
+     * memoized functions, default arguments) goes through the call in mapApply.
+     */
+    void mapElements(HeapThunk *fn, HeapArray *arr)
+    {
+        auto *func = static_cast<HeapClosure*>(fn->content.v.h);
+        bool inline_body = func->body != nullptr && func->memo == nullptr
+                           && func->params.size() == 1;
+        for (auto &el : arr->elements) {
+            HeapThunk *arg = el;
+            if (inline_body) {
+                el = makeHeap<HeapThunk>(idArrayElement, func->self, func->offset, func->body);
+                el->upValues = makeHeap<HeapEnv>(func->upValues,
+                                                 BindingFrame{{func->params[0].id, arg}});
+            } else {
+                el = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, mapApply);
+                el->upValues = makeHeap<HeapEnv>(
+                    nullptr, BindingFrame{{idMapFunc, fn}, {idMapElement, arg}});
+            }
+        }
+    }
+
+    /** Turn the builtin's frame into one that calls func on each element of arr, keeping those
+     * for which it returns true.
+     */
+    const AST *filter(const LocationRange &loc, FrameKind kind, const Value &func,
+                      const Value &arr)
+    {
+        Frame &f = stack.top();
+        const auto &ast = *static_cast<const Apply*>(f.ast);
+        if (static_cast<HeapClosure*>(func.v.h)->params.size() != 1) {
+            throw makeError(loc, "filter function takes 1 parameter.");
+        }
+        if (static_cast<HeapArray*>(arr.v.h)->elements.size() == 0) {
+            scratch = makeArray({});
             return nullptr;
+        }
+        f.kind = kind;
+        f.val = func;
+        f.val2 = arr;
+        f.elementId = 0;
+        auto *thunk = static_cast<HeapArray*>(arr.v.h)->elements[0];
+        return callFunction(ast, func, {thunk});
+    }
+
+    const AST *builtinFilter(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "filter", args, {Value::FUNCTION, Value::ARRAY});
+        stack.top().extra->thunks.clear();
+        return filter(loc, FRAME_BUILTIN_FILTER, args[0], args[1]);
+    }
+
+    const AST *builtinFilterMap(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        Frame &f = stack.top();
+        if (args[0].t != Value::FUNCTION) {
+            throw makeError(loc, "std.filterMap first param must be function, got "
+                                 + std_type_str(args[0]));
+        }
+        if (args[1].t != Value::FUNCTION) {
+            throw makeError(loc, "std.filterMap second param must be function, got "
+                                 + std_type_str(args[1]));
+        }
+        if (args[2].t != Value::ARRAY) {
+            throw makeError(loc, "std.filterMap third param must be array, got "
+                                 + std_type_str(args[2]));
+        }
+        // The kept elements follow the thunk holding map_func.
+        HeapThunk *map_func = f.extra->thunks[1];
+        f.extra->thunks.clear();
+        f.extra->thunks.push_back(map_func);
+        return filter(loc, FRAME_BUILTIN_FILTER_MAP, args[0], args[2]);
+    }
+
+    const AST *builtinMap(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        Frame &f = stack.top();
+        if (args[0].t != Value::FUNCTION) {
+            throw makeError(loc, "std.map first param must be function, got "
+                                 + std_type_str(args[0]));
+        }
+        if (args[1].t != Value::ARRAY && args[1].t != Value::STRING) {
+            throw makeError(loc, "std.map second param must be array / string, got "
+                                 + std_type_str(args[1]));
+        }
+        auto *arr = arrayOrChars(loc, "std.map second", args[1], f.val2);
+        scratch = makeArray(arr->elements);
+        mapElements(f.extra->thunks[0], static_cast<HeapArray*>(scratch.v.h));
+        return nullptr;
+    }
+
+    /** Turn the builtin's frame into one that calls func on the running value and each element
+     * of arr in turn, starting with init.
+     */
+    const AST *fold(const LocationRange &loc, const std::string &name, FrameKind kind,
+                    const std::vector<Value> &args)
+    {
+        Frame &f = stack.top();
+        if (args[0].t != Value::FUNCTION) {
+            throw makeError(loc, name + " first param must be function, got "
+                                 + std_type_str(args[0]));
+        }
+        if (args[1].t != Value::ARRAY && args[1].t != Value::STRING) {
+            throw makeError(loc, name + " second param must be array / string, got "
+                                 + std_type_str(args[1]));
+        }
+        f.val2 = args[1];
+        arrayOrChars(loc, name + " second", args[1], f.val2);
+        HeapThunk *init = f.extra->thunks[2];
+        f.kind = kind;
+        f.val = args[0];
+        f.extra->thunks.clear();
+        f.extra->thunks.push_back(init);
+        f.elementId = 0;
+        // The frame makes the calls.
+        return nullLiteral;
+    }
+
+    const AST *builtinFoldl(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        return fold(loc, "std.foldl", FRAME_BUILTIN_FOLDL, args);
+    }
+
+    const AST *builtinFoldr(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        return fold(loc, "std.foldr", FRAME_BUILTIN_FOLDR, args);
+    }
+
+    const AST *builtinFlattenArrays(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        Frame &f = stack.top();
+        validateBuiltinArgs(loc, "flattenArrays", args, {Value::ARRAY});
+        f.kind = FRAME_BUILTIN_FLATTEN_ARRAYS;
+        f.val2 = args[0];
+        f.extra->thunks.clear();
+        f.elementId = 0;
+        // The frame forces the arrays.
+        return nullLiteral;
+    }
+
+    /** The visible fields of obj, in the order in which they are manifested. */
+    std::map<String, const Identifier*> sortedFields(const HeapObject *obj)
+    {
+        std::map<String, const Identifier*> fields;
+        for (const auto &f : objectFields(obj, true)) {
+            fields[f->name] = f;
+        }
+        return fields;
+    }
+
+    const AST *builtinEscapeStringJson(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        String out;
+        if (args[0].t == Value::STRING) {
+            escape_string_json(static_cast<HeapString*>(args[0].v.h)->value(), out);
+        } else {
+            scratch = args[0];
+            escape_string_json(toString(loc), out);
+        }
+        scratch = makeString(out);
+        return nullptr;
+    }
+
+    const AST *builtinEscapeStringBash(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        String out = U"'";
+        if (args[0].t == Value::STRING) {
+            jsonlang_string_escape_bash(static_cast<HeapString*>(args[0].v.h)->value(), out);
+        } else {
+            scratch = args[0];
+            jsonlang_string_escape_bash(toString(loc), out);
+        }
+        out += U"'";
+        scratch = makeString(out);
+        return nullptr;
+    }
+
+    const AST *builtinEscapeStringDollars(const LocationRange &loc,
+                                          const std::vector<Value> &args)
+    {
+        String out;
+        if (args[0].t == Value::STRING) {
+            jsonlang_string_escape_dollars(static_cast<HeapString*>(args[0].v.h)->value(), out);
+        } else {
+            scratch = args[0];
+            jsonlang_string_escape_dollars(toString(loc), out);
+        }
+        scratch = makeString(out);
+        return nullptr;
+    }
+
+    const AST *builtinBase64(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        const char *sanity = "Can only base64 encode strings / arrays of single bytes.";
+        std::string bytes;
+        if (args[0].t == Value::STRING) {
+            const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+            bytes.reserve(str.length());
+            for (char32_t c : str) {
+                if (c >= 256) throw makeError(loc, sanity);
+                bytes += char(c);
+            }
+        } else if (args[0].t == Value::ARRAY) {
+            const auto &elements = static_cast<HeapArray*>(args[0].v.h)->elements;
+            bytes.reserve(elements.size());
+            for (auto *th : elements) {
+                const Value &el = forceThunk(loc, th);
+                if (el.t != Value::DOUBLE || el.v.d >= 256) throw makeError(loc, sanity);
+                // Only the low 8 bits were ever used, as by the & operator.
+                bytes += char(long(el.v.d));
+            }
+        } else {
+            throw makeError(loc, "std.base64 param must be array / string, got "
+                                 + std_type_str(args[0]));
+        }
+        String out;
+        jsonlang_base64_encode(bytes, out);
+        scratch = makeString(out);
+        return nullptr;
+    }
+
+    /** Shared by std.base64DecodeBytes and std.base64Decode, with their errors. */
+    std::string base64Decode(const LocationRange &loc, const std::string &name,
+                             const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, name, args, {Value::STRING});
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        if (str.length() % 4 != 0) {
+            throw makeError(loc, "Not a base64 encoded string \"" + encode_utf8(str) + "\"");
+        }
+        std::string bytes;
+        std::size_t bad = jsonlang_base64_decode(str, bytes);
+        if (bad != str.length()) {
+            throw makeError(loc, "Field does not exist: " + encode_utf8(str.substr(bad, 1)));
+        }
+        return bytes;
+    }
+
+    const AST *builtinBase64DecodeBytes(const LocationRange &loc,
+                                        const std::vector<Value> &args)
+    {
+        std::string bytes = base64Decode(loc, "base64DecodeBytes", args);
+        scratch = makeArray({});
+        auto &elements = static_cast<HeapArray*>(scratch.v.h)->elements;
+        elements.reserve(bytes.length());
+        for (unsigned char b : bytes) {
+            auto *th = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, nullptr);
+            elements.push_back(th);
+            th->fill(makeDouble(b));
+        }
+        return nullptr;
+    }
+
+    const AST *builtinBase64Decode(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        std::string bytes = base64Decode(loc, "base64Decode", args);
+        String str;
+        str.reserve(bytes.length());
+        for (unsigned char b : bytes) str += char32_t(b);
+        scratch = makeString(str);
+        return nullptr;
+    }
+
+    const AST *builtinManifestJsonEx(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        String indent;
+        if (args[1].t == Value::STRING) {
+            indent = static_cast<HeapString*>(args[1].v.h)->value();
+        } else {
+            scratch = args[1];
+            indent = toString(loc);
+        }
+        ManifestState state(MANIFEST_JSON_EX, true, indent, U"");
+        scratch = args[0];
+        manifestJson(loc, state);
+        scratch = makeString(state.out);
+        return nullptr;
+    }
+
+    const AST *builtinManifestYamlStream(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        if (args[0].t != Value::ARRAY) {
+            throw makeError(loc, "manifestYamlStream only takes arrays, got "
+                                 + std_type_str(args[0]));
+        }
+        auto *arr = static_cast<HeapArray*>(args[0].v.h);
+        ManifestState state(MANIFEST_JSON_EX, true, U"    ", U"");
+        state.out = U"---\n";
+        scratch = args[0];
+        for (unsigned long i = 0 ; i < arr->elements.size() ; ++i) {
+            auto *thunk = arr->elements[i];
+            if (i > 0) state.out += U"\n---\n";
+            stack.newCall(loc, thunk, thunk->self, thunk->offset, thunk->upValues);
+            stack.top().val = scratch;
+            if (thunk->filled) {
+                scratch = thunk->content;
+            } else {
+                evaluate(thunk->body, stack.size());
+            }
+            manifestJson(loc, state);
+            scratch = stack.top().val;
+            stack.pop();
+        }
+        state.out += U"\n...\n";
+        scratch = makeString(state.out);
+        return nullptr;
+    }
+
+    /** Append a "name = value" line for each visible field of the object in scratch, as
+     * std.manifestIni does for the main section and each of the others.
+     */
+    void manifestIniBody(const LocationRange &loc, String &out)
+    {
+        if (scratch.t != Value::OBJECT) {
+            throw makeError(loc, "std.manifestIni section must be an object, got "
+                                 + std_type_str(scratch));
+        }
+        auto *obj = static_cast<HeapObject*>(scratch.v.h);
+        auto fields = sortedFields(obj);
+        if (fields.size() > 0) runInvariants(loc, obj);
+        for (const auto &f : fields) {
+            const AST *body = objectIndex(loc, obj, f.second, 0);
+            stack.top().val = scratch;
+            evaluate(body, stack.size());
+            out += f.first;
+            out += U" = ";
+            if (scratch.t == Value::STRING) {
+                out += static_cast<HeapString*>(scratch.v.h)->value();
+            } else {
+                out += toString(body->location);
+            }
+            out += U"\n";
+            scratch = stack.top().val;
+            stack.pop();
+        }
+    }
+
+    const AST *builtinManifestIni(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "manifestIni", args, {Value::OBJECT});
+        auto *ini = static_cast<HeapObject*>(args[0].v.h);
+        String out;
+        // The sections field is always indexed.
+        runInvariants(loc, ini);
+        scratch = args[0];
+        auto fields = sortedFields(ini);
+        auto main = fields.find(U"main");
+        if (main != fields.end()) {
+            const AST *body = objectIndex(loc, ini, main->second, 0);
+            stack.top().val = scratch;
+            evaluate(body, stack.size());
+            manifestIniBody(body->location, out);
+            scratch = stack.top().val;
+            stack.pop();
+        }
+        const AST *body = objectIndex(loc, ini, alloc->makeIdentifier(U"sections"), 0);
+        stack.top().val = scratch;
+        evaluate(body, stack.size());
+        if (scratch.t != Value::OBJECT) {
+            throw makeError(body->location, "std.manifestIni sections must be an object, got "
+                                            + std_type_str(scratch));
+        }
+        auto *sections = static_cast<HeapObject*>(scratch.v.h);
+        auto section_fields = sortedFields(sections);
+        if (section_fields.size() > 0) runInvariants(loc, sections);
+        for (const auto &f : section_fields) {
+            const AST *sbody = objectIndex(loc, sections, f.second, 0);
+            stack.top().val = scratch;
+            evaluate(sbody, stack.size());
+            out += U"[";
+            out += f.first;
+            out += U"]\n";
+            manifestIniBody(sbody->location, out);
+            scratch = stack.top().val;
+            stack.pop();
+        }
+        stack.pop();
+        scratch = makeString(out);
+        return nullptr;
+    }
+
+    const AST *builtinManifestPython(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        ManifestState state(MANIFEST_PYTHON, false, U"", U"");
+        scratch = args[0];
+        manifestJson(loc, state);
+        scratch = makeString(state.out);
+        return nullptr;
+    }
+
+    const AST *builtinManifestPythonVars(const LocationRange &loc,
+                                         const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "manifestPythonVars", args, {Value::OBJECT});
+        auto *conf = static_cast<HeapObject*>(args[0].v.h);
+        auto fields = sortedFields(conf);
+        if (fields.size() > 0) runInvariants(loc, conf);
+        ManifestState state(MANIFEST_PYTHON, false, U"", U"");
+        scratch = args[0];
+        for (const auto &f : fields) {
+            const AST *body = objectIndex(loc, conf, f.second, 0);
+            stack.top().val = scratch;
+            evaluate(body, stack.size());
+            state.out += f.first;
+            state.out += U" = ";
+            manifestJson(body->location, state);
+            state.out += U"\n";
+            scratch = stack.top().val;
+            stack.pop();
+        }
+        scratch = makeString(state.out);
+        return nullptr;
+    }
+
+    /** A new thunk that evaluates obj.f (which must exist) when forced.
+     *
+     * It evaluates the field's own body with obj as self, so the field is not copied.  A field
+     * of a JSON-like object (e.g. the result of std.mergePatch) is the very same thunk.
+     */
+    HeapThunk *fieldThunk(HeapObject *obj, const Identifier *f)
+    {
+        unsigned found_at = 0;
+        HeapLeafObject *found = findObject(f, obj, 0, found_at);
+        if (auto *simp = dynamic_cast<HeapSimpleObject*>(found)) {
+            auto *th = makeHeap<HeapThunk>(f, obj, found_at, simp->fields.find(f)->second.body);
+            th->upValues = simp->upValues;
+            return th;
+        }
+        auto *comp = static_cast<HeapComprehensionObject*>(found);
+        auto *value = comp->compValues.find(f)->second;
+        if (comp->value == jsonObjVar) return value;
+        auto *th = makeHeap<HeapThunk>(f, obj, found_at, comp->value);
+        // The environment is made once th is reachable from the caller's stack frame.
+        stack.top().extra->thunks.push_back(th);
+        th->upValues = makeHeap<HeapEnv>(comp->upValues, BindingFrame{{comp->id, value}});
+        return th;
+    }
+
+    /** RFC 7386 merge patch, as the original std.mergePatch.
+     *
+     * Only the visible fields of the patch are forced (to find the nulls).  The result shares
+     * the target's fields that are not patched, and its patched objects are merged lazily by
+     * calls to std.mergePatch.
+     */
+    const AST *builtinMergePatch(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        if (args[1].t != Value::OBJECT) {
+            scratch = args[1];
+            return nullptr;
+        }
+        auto *patch = static_cast<HeapObject*>(args[1].v.h);
+        auto *target = args[0].t == Value::OBJECT ? static_cast<HeapObject*>(args[0].v.h)
+                                                  : nullptr;
+        auto patch_fields = sortedFields(patch);
+        std::map<String, const Identifier*> target_fields;
+        if (target != nullptr) target_fields = sortedFields(target);
+        // The original indexed both objects, which checks their assertions.
+        if (patch_fields.size() > 0) runInvariants(loc, patch);
+        if (target_fields.size() > 0) runInvariants(loc, target);
+
+        stack.top().val2 = makeObject<HeapComprehensionObject>(
+            nullptr, jsonObjVar, idJsonObjVar, BindingFrame{});
+        auto *result = static_cast<HeapComprehensionObject*>(stack.top().val2.v.h);
+        auto *func = makeHeap<HeapThunk>(idMapFunc, nullptr, 0, nullptr);
+        stack.top().extra->thunks.push_back(func);
+        func->fill(stack.top().val);
+        auto *null_target = makeHeap<HeapThunk>(idMergeTarget, nullptr, 0, nullptr);
+        stack.top().extra->thunks.push_back(null_target);
+        null_target->fill(makeNull());
+
+        for (const auto &f : patch_fields) {
+            const AST *body = objectIndex(loc, patch, f.second, 0);
+            evaluate(body, stack.size());
+            stack.pop();
+            if (scratch.t == Value::NULL_TYPE) continue;
+            auto *value = makeHeap<HeapThunk>(idMergePatch, nullptr, 0, nullptr);
+            stack.top().extra->thunks.push_back(value);
+            value->fill(scratch);
+            if (scratch.t != Value::OBJECT) {
+                result->compValues[f.second] = value;
+                continue;
+            }
+            auto *th = makeHeap<HeapThunk>(idJsonObjVar, nullptr, 0, mergePatchApply);
+            result->compValues[f.second] = th;
+            HeapThunk *sub_target = null_target;
+            if (target_fields.find(f.first) != target_fields.end()) {
+                sub_target = fieldThunk(target, f.second);
+                stack.top().extra->thunks.push_back(sub_target);
+            }
+            th->upValues = makeHeap<HeapEnv>(
+                nullptr,
+                BindingFrame{{idMapFunc, func}, {idMergeTarget, sub_target},
+                             {idMergePatch, value}});
+        }
+        for (const auto &f : target_fields) {
+            if (patch_fields.find(f.first) != patch_fields.end()) continue;
+            auto *th = fieldThunk(target, f.second);
+            result->compValues[f.second] = th;
+        }
+        scratch = stack.top().val2;
+        return nullptr;
+    }
+
+    const AST *builtinObjectHasEx(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "objectHasEx", args,
+                            {Value::OBJECT, Value::STRING,
+                             Value::BOOLEAN});
+        const auto *obj = static_cast<const HeapObject*>(args[0].v.h);
+        const auto *str = static_cast<const HeapString*>(args[1].v.h);
+        bool include_hidden = args[2].v.b;
+        bool found = false;
+        // Without an interned identifier, no object can have the field.
+        if (const Identifier *id = alloc->findIdentifier(str->value())) {
+            const auto &hide = objectFieldIndex(obj).hide;
+            auto it = hide.find(id);
+            found = it != hide.end() && (include_hidden || it->second != ObjectField::HIDDEN);
+        }
+        scratch = makeBoolean(found);
+        return nullptr;
+    }
+
+    /** The result of std.length(v). */
+    unsigned long length(const LocationRange &loc, const Value &v)
+    {
+        HeapEntity *e = v.v.h;
+        switch (v.t) {
+            case Value::OBJECT:
+            return objectFieldIndex(static_cast<HeapObject*>(e)).numVisible;
+
+            case Value::ARRAY:
+            return static_cast<HeapArray*>(e)->elements.size();
+
+            case Value::STRING:
+            return static_cast<HeapString*>(e)->value().length();
+
+            case Value::FUNCTION:
+            return static_cast<HeapClosure*>(e)->params.size();
+
+            default:
+            throw makeError(loc,
+                            "length operates on strings, objects, "
+                            "and arrays, got " + type_str(v));
+        }
+    }
+
+    const AST *builtinLength(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        if (args.size() != 1) {
+            throw makeError(loc, "length takes 1 parameter.");
+        }
+        scratch = makeDouble(length(loc, args[0]));
+        return nullptr;
+    }
+
+    const AST *builtinObjectFieldsEx(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "objectFieldsEx", args,
+                            {Value::OBJECT, Value::BOOLEAN});
+        const auto *obj = static_cast<HeapObject*>(args[0].v.h);
+        bool include_hidden = args[1].v.b;
+        objectFieldIndex(obj);
+        // Arrays are never changed in place, so every call can share the same one.
+        HeapArray *&names = include_hidden ? obj->fieldIndex->allNames
+                                           : obj->fieldIndex->visibleNames;
+        if (names == nullptr) {
+            // Stash in a set first to sort them.
+            std::set<String> fields;
+            for (const auto &field : objectFields(obj, !include_hidden)) {
+                fields.insert(field->name);
+            }
+            scratch = makeArray({});
+            auto &elements = static_cast<HeapArray*>(scratch.v.h)->elements;
+            for (const auto &field : fields) {
+                auto *th = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, nullptr);
+                elements.push_back(th);
+                th->fill(makeString(field));
+            }
+            names = static_cast<HeapArray*>(scratch.v.h);
+        }
+        scratch.t = Value::ARRAY;
+        scratch.v.h = names;
+        return nullptr;
+    }
+
+    const AST *builtinCodepoint(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "codepoint", args, {Value::STRING});
+        const String &str =
+            static_cast<HeapString*>(args[0].v.h)->value();
+        if (str.length() != 1) {
+            std::stringstream ss;
+            ss << "codepoint takes a string of length 1, got length "
+               << str.length();
+            throw makeError(loc, ss.str());
+        }
+        char32_t c = static_cast<HeapString*>(args[0].v.h)->value()[0];
+        scratch = makeDouble((unsigned long)(c));
+        return nullptr;
+    }
+
+    const AST *builtinChar(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "char", args, {Value::DOUBLE});
+        long l = long(args[0].v.d);
+        if (l < 0) {
+            std::stringstream ss;
+            ss << "Codepoints must be >= 0, got " << l;
+            throw makeError(loc, ss.str());
+        }
+        if (l >= JSONLANG_CODEPOINT_MAX) {
+            std::stringstream ss;
+            ss << "Invalid unicode codepoint, got " << l;
+            throw makeError(loc, ss.str());
+        }
+        char32_t c = l;
+        scratch = makeString(String(&c, 1));
+        return nullptr;
+    }
+
+    /** The value of the digits of str in the given base, as the foldl of 10 * a + d that
+     * std.parseInt used to be, so large numbers round the same way.
+     *
+     * \param minus Whether a leading "-" negates the result.
+     * \param err The message of the error raised for any other character.
+     */
+    double parseDigits(const LocationRange &loc, const String &str, unsigned base, bool minus,
+                       const std::string &err)
+    {
+        bool negative = minus && str.length() > 0 && str[0] == U'-';
+        size_t i = negative ? 1 : 0;
+        if (i == str.length()) throw makeError(loc, err);
+        double r = 0;
+        for ( ; i < str.length() ; ++i) {
+            char32_t c = str[i];
+            unsigned digit;
+            if (c >= U'0' && c <= U'9') {
+                digit = c - U'0';
+            } else if (c >= U'a' && c <= U'f') {
+                digit = c - U'a' + 10;
+            } else if (c >= U'A' && c <= U'F') {
+                digit = c - U'A' + 10;
+            } else {
+                throw makeError(loc, err);
+            }
+            if (digit >= base) throw makeError(loc, err);
+            r = base * r + digit;
+        }
+        return negative ? -r : r;
+    }
+
+    const AST *builtinParseInt(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "parseInt", args, {Value::STRING});
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        scratch = makeDouble(parseDigits(
+            loc, str, 10, true, "parseInt got string which does not match regex [0-9]+"));
+        return nullptr;
+    }
+
+    const AST *builtinParseOctal(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "parseOctal", args, {Value::STRING});
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        scratch = makeDouble(parseDigits(
+            loc, str, 8, false, "Not an octal number: \"" + encode_utf8(str) + "\""));
+        return nullptr;
+    }
+
+    const AST *builtinParseHex(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "parseHex", args, {Value::STRING});
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        scratch = makeDouble(parseDigits(
+            loc, str, 16, false, "Not hexadecimal: \"" + encode_utf8(str) + "\""));
+        return nullptr;
+    }
+
+    /** Force a thunk from native code, e.g. an element of an array given to a builtin.
+     *
+     * This re-enters the interpreter, so the caller must keep anything it needs reachable from
+     * the stack.  Clobbers scratch.
+     */
+    const Value &forceThunk(const LocationRange &loc, HeapThunk *th)
+    {
+        if (!th->filled) {
+            stack.newCall(loc, th, th->self, th->offset, th->upValues);
+            evaluate(th->body, stack.size());
+            th->fill(scratch);
+            stack.pop();
+        }
+        return th->content;
+    }
+
+    /** The string str[from], str[from + 1], ... str[from + len - 1].
+     *
+     * This has the same (character by character) bounds checking as the string indexing it
+     * replaced in std.substr.
+     */
+    String substr(const LocationRange &loc, const String &str, double from, double len)
+    {
+        long sz = str.length();
+        long n = long(len);
+        String r;
+        r.reserve(n > 0 ? n : 0);
+        for (long i = 0 ; i < n ; ++i) {
+            long j = long(i + from);
+            if (j < 0 || j >= sz) {
+                std::stringstream ss;
+                ss << "String bounds error: " << j << " not within [0, " << sz << ")";
+                throw makeError(loc, ss.str());
+            }
+            r.push_back(str[j]);
+        }
+        return r;
+    }
+
+    const AST *builtinSubstr(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        if (args[0].t != Value::STRING) {
+            throw makeError(loc, "substr first parameter should be a string, got "
+                                 + std_type_str(args[0]));
+        }
+        if (args[1].t != Value::DOUBLE) {
+            throw makeError(loc, "substr second parameter should be a number, got "
+                                 + std_type_str(args[1]));
+        }
+        if (args[2].t != Value::DOUBLE) {
+            throw makeError(loc, "substr third parameter should be a number, got "
+                                 + std_type_str(args[2]));
+        }
+        if (args[2].v.d < 0) {
+            throw makeError(loc, "substr third parameter should be greater than zero, got "
+                                 + jsonlang_unparse_number(args[2].v.d));
+        }
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        scratch = makeString(substr(loc, str, args[1].v.d, args[2].v.d));
+        return nullptr;
+    }
+
+    /** Shared by std.startsWith and std.endsWith. */
+    void startsOrEndsWith(const LocationRange &loc, const std::vector<Value> &args, bool ends)
+    {
+        unsigned long la = length(loc, args[0]);
+        unsigned long lb = length(loc, args[1]);
+        if (la < lb) {
+            scratch = makeBoolean(false);
+            return;
+        }
+        if (args[0].t != Value::STRING) {
+            throw makeError(loc, "substr first parameter should be a string, got "
+                                 + std_type_str(args[0]));
+        }
+        if (args[1].t != Value::STRING) {
+            scratch = makeBoolean(false);
+            return;
+        }
+        const String &a = static_cast<HeapString*>(args[0].v.h)->value();
+        const String &b = static_cast<HeapString*>(args[1].v.h)->value();
+        scratch = makeBoolean(a.compare(ends ? la - lb : 0, lb, b) == 0);
+    }
+
+    const AST *builtinStartsWith(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        startsOrEndsWith(loc, args, false);
+        return nullptr;
+    }
+
+    const AST *builtinEndsWith(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        startsOrEndsWith(loc, args, true);
+        return nullptr;
+    }
+
+    const AST *builtinStringChars(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        switch (args[0].t) {
+            case Value::STRING: break;
+
+            case Value::ARRAY:
+            scratch = makeArray(static_cast<HeapArray*>(args[0].v.h)->elements);
+            return nullptr;
+
+            case Value::OBJECT:
+            case Value::FUNCTION:
+            if (length(loc, args[0]) == 0) {
+                scratch = makeArray({});
+                return nullptr;
+            }
+            if (args[0].t == Value::OBJECT)
+                throw makeError(loc, "Object index must be string, got double.");
+            throw makeError(loc, "Can only index objects, strings, and arrays, got function.");
+
+            default:
+            length(loc, args[0]);  // Throws the error.
+        }
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        scratch = makeArray({});
+        auto &elements = static_cast<HeapArray*>(scratch.v.h)->elements;
+        elements.reserve(str.length());
+        for (char32_t c : str) {
+            auto *th = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, nullptr);
+            elements.push_back(th);
+            th->fill(makeString(String(&c, 1)));
+        }
+        return nullptr;
+    }
+
+    /** Shared by std.split and std.splitLimit, which only differ in their error messages. */
+    void splitLimit(const LocationRange &loc, const std::string &name,
+                    const std::vector<Value> &args)
+    {
+        if (args[0].t != Value::STRING) {
+            throw makeError(loc, name + " first parameter should be a string, got "
+                                 + std_type_str(args[0]));
+        }
+        if (args[1].t != Value::STRING) {
+            throw makeError(loc, name + " second parameter should be a string, got "
+                                 + std_type_str(args[1]));
+        }
+        const String &str = static_cast<HeapString*>(args[0].v.h)->value();
+        const String &c = static_cast<HeapString*>(args[1].v.h)->value();
+        if (c.length() != 1) {
+            throw makeError(loc, name + " second parameter should have length 1, got "
+                                 + jsonlang_unparse_number(c.length()));
+        }
+        if (args[2].t != Value::DOUBLE) {
+            throw makeError(loc, name + " third parameter should be a number, got "
+                                 + std_type_str(args[2]));
+        }
+        double maxsplits = args[2].v.d;
+        std::vector<String> parts;
+        size_t start = 0;
+        for (size_t i = 0 ; i < str.length() ; ++i) {
+            if (str[i] == c[0] && (maxsplits == -1 || parts.size() < maxsplits)) {
+                parts.push_back(str.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+        parts.push_back(str.substr(start));
+
+        scratch = makeArray({});
+        auto &elements = static_cast<HeapArray*>(scratch.v.h)->elements;
+        elements.reserve(parts.size());
+        for (const auto &part : parts) {
+            auto *th = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, nullptr);
+            elements.push_back(th);
+            th->fill(makeString(part));
+        }
+    }
+
+    const AST *builtinSplit(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        std::vector<Value> args2 = args;
+        args2.push_back(makeDouble(-1));
+        splitLimit(loc, "std.split", args2);
+        return nullptr;
+    }
+
+    const AST *builtinSplitLimit(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        splitLimit(loc, "std.splitLimit", args);
+        return nullptr;
+    }
+
+    const AST *builtinJoin(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        Frame &f = stack.top();
+        const Value &sep = args[0];
+        if (args[1].t != Value::ARRAY) {
+            throw makeError(loc, "join second parameter should be array, got "
+                                 + std_type_str(args[1]));
+        }
+        if (sep.t != Value::STRING && sep.t != Value::ARRAY) {
+            throw makeError(loc, "join first parameter should be string or array, got "
+                                 + std_type_str(sep));
+        }
+        f.kind = FRAME_BUILTIN_JOIN;
+        f.val = sep;
+        f.val2 = args[1];
+        f.extra->thunks.clear();
+        f.extra->str.clear();
+        f.extra->joinString = sep.t == Value::STRING;
+        f.extra->joinFirst = true;
+        f.elementId = 0;
+        // The frame forces the elements, in order.
+        return nullLiteral;
+    }
+
+    /** Add v to the result of the FRAME_BUILTIN_JOIN on top of the stack, as + would.
+     *
+     * An array result becomes a string when a string is added to it.  Clobbers scratch.
+     */
+    void joinAppend(const LocationRange &loc, Value v)
+    {
+        FrameExtra *extra = stack.top().extra;
+        if (!extra->joinString) {
+            if (v.t == Value::ARRAY) {
+                const auto &els = static_cast<HeapArray*>(v.v.h)->elements;
+                extra->thunks.insert(extra->thunks.end(), els.begin(), els.end());
+                return;
+            }
+            if (v.t != Value::STRING) {
+                throw makeError(loc, "Binary operator + requires matching types, got array and "
+                                     + type_str(v) + ".");
+            }
+            scratch = makeArray(extra->thunks);
+            extra->str = toString(loc);
+            extra->thunks.clear();
+            extra->joinString = true;
+        }
+        if (v.t == Value::STRING) {
+            extra->str += static_cast<HeapString*>(v.v.h)->value();
+        } else {
+            // Same coercion as the + operator.
+            scratch = v;
+            extra->str += toString(loc);
+        }
+    }
+
+    /** Parse a std.format string into literal text and % conversions.
+     *
+     * This accepts the same language, and raises the same errors, as the std.jsonlang parser
+     * it replaced.
+     */
+    std::vector<FormatCode> parseFormat(const LocationRange &loc, const String &str)
+    {
+        std::vector<FormatCode> codes;
+        FormatCode text;
+        size_t i = 0;
+        auto next = [&]() -> char32_t {
+            if (i >= str.length())
+                throw makeError(loc, "Truncated format code.");
+            return str[i];
+        };
+        // Field width and precision are * or a (possibly empty) sequence of digits.
+        auto field_width = [&](double &v, bool &star) {
+            if (i < str.length() && str[i] == '*') {
+                star = true;
+                i++;
+                return;
+            }
+            v = 0;
+            for (char32_t c = next() ; c >= '0' && c <= '9' ; c = next()) {
+                v = makeDoubleCheck(loc, v * 10).v.d;
+                v = makeDoubleCheck(loc, v + (c - '0')).v.d;
+                i++;
+            }
+        };
+        while (i < str.length()) {
+            if (str[i] != '%') {
+                text.text.push_back(str[i++]);
+                continue;
+            }
+            i++;
+            if (text.text.length() > 0) {
+                codes.push_back(text);
+                text.text.clear();
+            }
+            FormatCode code;
+
+            if (next() == '(') {
+                code.hasMkey = true;
+                i++;
+                for (char32_t c = next() ; c != ')' ; c = next()) {
+                    code.text.push_back(c);
+                    i++;
+                }
+                i++;
+            }
+
+            for (bool more = true ; more ; ) {
+                switch (next()) {
+                    case '#': code.alt = true; break;
+                    case '0': code.zero = true; break;
+                    case '-': code.left = true; break;
+                    case ' ': code.blank = true; break;
+                    case '+': code.sign = true; break;
+                    default: more = false; continue;
+                }
+                i++;
+            }
+
+            field_width(code.fw, code.fwStar);
+
+            if (next() == '.') {
+                i++;
+                code.hasPrec = true;
+                field_width(code.prec, code.precStar);
+            }
+
+            // Length modifiers are accepted and ignored.
+            char32_t c = next();
+            if (c == 'h' || c == 'l' || c == 'L') {
+                i++;
+                c = next();
+            }
+
+            switch (c) {
+                case 'd': case 'i': case 'u': code.ctype = 'd'; break;
+                case 'o': code.ctype = 'o'; break;
+                case 'x': case 'X': code.ctype = 'x'; break;
+                case 'e': case 'E': code.ctype = 'e'; break;
+                case 'f': case 'F': code.ctype = 'f'; break;
+                case 'g': case 'G': code.ctype = 'g'; break;
+                case 'c': code.ctype = 'c'; break;
+                case 's': code.ctype = 's'; break;
+                case '%': code.ctype = '%'; break;
+                default:
+                throw makeError(loc, "Unrecognised conversion type: " + encode_utf8(String(&c, 1)));
+            }
+            code.caps = c == 'X' || c == 'E' || c == 'F' || c == 'G';
+            i++;
+            codes.push_back(code);
+        }
+        if (text.text.length() > 0)
+            codes.push_back(text);
+        return codes;
+    }
+
+    /** str padded with c on the left (or the right) so that it is at least w long. */
+    String formatPad(const LocationRange &loc, const String &str, double w, char32_t c,
+                     bool right)
+    {
+        double n = makeDoubleCheck(loc, w - str.length()).v.d;
+        if (n <= 0)
+            return str;
+        String padding(size_t(std::ceil(n)), c);
+        return right ? str + padding : padding + str;
+    }
+
+    /** Render an integer (e.g., decimal or octal). */
+    String formatInt(const LocationRange &loc, double n__, double min_chars, double min_digits,
+                     bool blank, bool sign, double radix, const String &zero_prefix)
+    {
+        double n_ = n__ > 0 ? n__ : -n__;
+        double n = std::floor(n_);
+        String dec;
+        if (n == 0) {
+            dec = U"0";
+        } else {
+            for ( ; n != 0 ; n = std::floor(n / radix))
+                dec.push_back(U'0' + int(std::fmod(n, radix)));
+            dec += zero_prefix;
+            std::reverse(dec.begin(), dec.end());
+        }
+        bool neg = n__ < 0;
+        double zp = makeDoubleCheck(loc, min_chars - (neg || blank || sign ? 1 : 0)).v.d;
+        double zp2 = zp > min_digits ? zp : min_digits;
+        String dec2 = formatPad(loc, dec, zp2, U'0', false);
+        return (neg ? U"-" : sign ? U"+" : blank ? U" " : U"") + dec2;
+    }
+
+    /** Render an integer in hexadecimal. */
+    String formatHex(const LocationRange &loc, double n__, double min_chars, double min_digits,
+                     bool blank, bool sign, bool add_zerox, bool capitals)
+    {
+        const char32_t *numerals = capitals ? U"0123456789ABCDEF" : U"0123456789abcdef";
+        double n_ = n__ > 0 ? n__ : -n__;
+        double n = std::floor(n_);
+        String hex;
+        if (n == 0) {
+            hex = U"0";
+        } else {
+            for ( ; n != 0 ; n = std::floor(n / 16))
+                hex.push_back(numerals[int(std::fmod(n, 16))]);
+            std::reverse(hex.begin(), hex.end());
+        }
+        bool neg = n__ < 0;
+        double zp = makeDoubleCheck(loc, min_chars - (neg || blank || sign ? 1 : 0)
+                                              - (add_zerox ? 2 : 0)).v.d;
+        double zp2 = zp > min_digits ? zp : min_digits;
+        String hex2 = (add_zerox ? (capitals ? U"0X" : U"0x") : U"")
+                      + formatPad(loc, hex, zp2, U'0', false);
+        return (neg ? U"-" : sign ? U"+" : blank ? U" " : U"") + hex2;
+    }
+
+    /** Render floating point in decimal form.
+     *
+     * The arithmetic (and so the rounding, and the errors for e.g. zero) is exactly that of
+     * the std.jsonlang implementation this replaced.
+     */
+    String formatFloatDec(const LocationRange &loc, double n__, double zero_pad, bool blank,
+                          bool sign, bool ensure_pt, bool trailing, double prec)
+    {
+        double n_ = n__ > 0 ? n__ : -n__;
+        double whole = std::floor(n_);
+        double dot_size = prec == 0 && !ensure_pt ? 0 : 1;
+        auto str = [&]() {
+            if (n_ == 0)
+                throw makeError(loc, "Division by zero.");
+            double zp = makeDoubleCheck(loc, zero_pad - prec - dot_size).v.d;
+            return formatInt(loc, n__ / n_ * whole, zp, 0, blank, sign, 10, U"");
+        };
+        auto frac = [&]() {
+            double scale = makeDoubleCheck(loc, std::pow(10, prec)).v.d;
+            double v = makeDoubleCheck(loc, (n_ - whole) * scale).v.d;
+            return std::floor(makeDoubleCheck(loc, v + 0.5).v.d);
+        };
+        if (prec == 0)
+            return str() + (ensure_pt ? U"." : U"");
+        if (trailing) {
+            String s = str();
+            return s + U"." + formatInt(loc, frac(), prec, 0, false, false, 10, U"");
+        }
+        double f = frac();
+        if (f <= 0)
+            return str();
+        String s = str();
+        String frac_str = formatInt(loc, f, prec, 0, false, false, 10, U"");
+        size_t end = frac_str.find_last_not_of(U'0');
+        return s + U"." + frac_str.substr(0, end == String::npos ? 0 : end + 1);
+    }
+
+    /** Like std.floor(std.log(std.abs(n)) / std.log(10)). */
+    double formatExponent(const LocationRange &loc, double n)
+    {
+        double l = makeDoubleCheck(loc, std::log(n > 0 ? n : -n)).v.d;
+        return std::floor(makeDoubleCheck(loc, l / std::log(10)).v.d);
+    }
+
+    /** Render floating point in scientific form. */
+    String formatFloatSci(const LocationRange &loc, double n__, double zero_pad, bool blank,
+                          bool sign, bool ensure_pt, bool trailing, bool caps, double prec)
+    {
+        double exponent = formatExponent(loc, n__);
+        String suff = (caps ? U"E" : U"e")
+                      + formatInt(loc, exponent, 3, 0, false, true, 10, U"");
+        double scale = makeDoubleCheck(loc, std::pow(10, exponent)).v.d;
+        if (scale == 0)
+            throw makeError(loc, "Division by zero.");
+        double mantissa = makeDoubleCheck(loc, n__ / scale).v.d;
+        double zp2 = makeDoubleCheck(loc, zero_pad - suff.length()).v.d;
+        return formatFloatDec(loc, mantissa, zp2, blank, sign, ensure_pt, trailing, prec) + suff;
+    }
+
+    /** A field width given by *, which the std.jsonlang implementation subtracted from. */
+    double formatWidth(const LocationRange &loc, const Value &fw)
+    {
+        if (fw.t != Value::DOUBLE) {
+            throw makeError(loc, "Binary operator - requires matching types, got "
+                                 + type_str(fw) + " and double.");
+        }
+        return fw.v.d;
+    }
+
+    /** Render a value with a % conversion other than %%.
+     *
+     * The field width and precision are values because with * they come from the values being
+     * formatted; like the std.jsonlang implementation, they are only checked when used.  A
+     * null precision means none was given.  where is the index or mapping key of val, for
+     * errors.
+     */
+    String formatCode(const LocationRange &loc, const Value &val, const FormatCode &code,
+                      const Value &fw, const Value &prec, const std::string &where)
+    {
+        switch (code.ctype) {
+            case 's':
+            if (val.t == Value::STRING)
+                return static_cast<HeapString*>(val.v.h)->value();
+            scratch = val;
+            return toString(loc);
+
+            case 'c':
+            if (val.t == Value::DOUBLE) {
+                builtinChar(loc, {val});
+                return static_cast<HeapString*>(scratch.v.h)->value();
+            }
+            if (val.t == Value::STRING) {
+                const String &s = static_cast<HeapString*>(val.v.h)->value();
+                if (s.length() != 1) {
+                    throw makeError(loc, "%c expected 1-sized string got: "
+                                         + jsonlang_unparse_number(s.length()));
+                }
+                return s;
+            }
+            throw makeError(loc, "%c expected number / string, got: " + std_type_str(val));
+        }
+
+        if (val.t != Value::DOUBLE) {
+            throw makeError(loc, "Format required number at " + where + ", got "
+                                 + std_type_str(val));
+        }
+        double v = val.v.d;
+        double exponent = code.ctype == 'g' ? formatExponent(loc, v) : 0;
+        double zp = code.zero && !code.left ? formatWidth(loc, fw) : 0;
+        if (code.ctype == 'd' || code.ctype == 'o' || code.ctype == 'x') {
+            if (prec.t != Value::NULL_TYPE && prec.t != Value::DOUBLE) {
+                throw makeError(loc, "std.max second param expected number, got "
+                                     + std_type_str(prec));
+            }
+            double iprec = prec.t == Value::DOUBLE ? prec.v.d : 0;
+            if (code.ctype == 'x')
+                return formatHex(loc, v, zp, iprec, code.blank, code.sign, code.alt, code.caps);
+            return formatInt(loc, v, zp, iprec, code.blank, code.sign,
+                             code.ctype == 'd' ? 10 : 8,
+                             code.ctype == 'o' && code.alt ? U"0" : U"");
+        }
+
+        // The floating point conversions.
+        double fpprec = prec.t == Value::DOUBLE ? prec.v.d : 6;
+        if (prec.t != Value::NULL_TYPE && prec.t != Value::DOUBLE) {
+            if (code.ctype == 'g' && exponent >= -4) {
+                throw makeError(loc, "Binary operator >= requires matching types, got double "
+                                     "and " + type_str(prec) + ".");
+            }
+            if (code.ctype == 'g') {
+                throw makeError(loc, "Binary operator - requires matching types, got "
+                                     + type_str(prec) + " and double.");
+            }
+            throw makeError(loc, "Binary operator - requires matching types, got double and "
+                                 + type_str(prec) + ".");
+        }
+        switch (code.ctype) {
+            case 'f':
+            return formatFloatDec(loc, v, zp, code.blank, code.sign, code.alt, true, fpprec);
+
+            case 'e':
+            return formatFloatSci(loc, v, zp, code.blank, code.sign, code.alt, true, code.caps,
+                                  fpprec);
+
+            default:
+            if (exponent < -4 || exponent >= fpprec) {
+                return formatFloatSci(loc, v, zp, code.blank, code.sign, code.alt, code.alt,
+                                      code.caps, fpprec - 1);
+            }
+            double digits_before_pt = exponent + 1 > 1 ? exponent + 1 : 1;
+            return formatFloatDec(loc, v, zp, code.blank, code.sign, code.alt, code.alt,
+                                  fpprec - digits_before_pt);
+        }
+    }
+
+    /** std.format(str, vals), i.e. str % vals.
+     *
+     * The format string is parsed once per HeapString and the result kept on it.  Values are
+     * forced in the order, and errors raised as, in the std.jsonlang implementation.
+     */
+    String format(const LocationRange &loc, const HeapString *str, const Value &vals)
+    {
+        if (str->formatCodes == nullptr) {
+            str->formatCodes.reset(new std::vector<FormatCode>(parseFormat(loc, str->value())));
+        }
+        const std::vector<FormatCode> &codes = *str->formatCodes;
+        String r;
+
+        if (vals.t == Value::OBJECT) {
+            auto *obj = static_cast<HeapObject*>(vals.v.h);
+            for (const auto &code : codes) {
+                if (code.ctype == 0) {
+                    r += code.text;
+                    continue;
+                }
+                auto fw = [&]() {
+                    if (code.fwStar)
+                        throw makeError(loc, "Cannot use * field width with object.");
+                    return code.fw;
+                };
+                auto s = [&]() -> String {
+                    if (code.ctype == '%')
+                        return U"%";
+                    if (!code.hasMkey)
+                        throw makeError(loc, "Mapping keys required.");
+                    const Identifier *field = nullptr;
+                    for (const auto *f : objectFields(obj, false)) {
+                        if (f->name == code.text) field = f;
+                    }
+                    std::string key = encode_utf8(code.text);
+                    if (field == nullptr)
+                        throw makeError(loc, "No such field: " + key);
+                    // pushes FRAME_CALL
+                    const AST *body = objectIndex(loc, obj, field, 0);
+                    evaluate(body, stack.size());
+                    stack.top().val = scratch;
+                    if (code.precStar && code.ctype != 's' && code.ctype != 'c')
+                        throw makeError(loc, "Cannot use * precision with object.");
+                    Value prec = code.hasPrec ? makeDouble(code.prec) : makeNull();
+                    String v = formatCode(loc, stack.top().val, code, makeDouble(code.fw),
+                                          prec, key);
+                    stack.pop();
+                    return v;
+                };
+                if (code.left) {
+                    String v = s();
+                    r += formatPad(loc, v, fw(), U' ', true);
+                } else {
+                    double w = fw();
+                    r += formatPad(loc, s(), w, U' ', false);
+                }
+            }
+            return r;
+        }
+
+        const std::vector<HeapThunk*> *elements = nullptr;
+        size_t num_vals = 1;
+        if (vals.t == Value::ARRAY) {
+            elements = &static_cast<HeapArray*>(vals.v.h)->elements;
+            num_vals = elements->size();
+        }
+        auto get = [&](size_t j) {
+            return elements == nullptr ? vals : forceThunk(loc, (*elements)[j]);
+        };
+        size_t j = 0;
+        for (const auto &code : codes) {
+            if (code.ctype == 0) {
+                r += code.text;
+                continue;
+            }
+            size_t fw_j = j;
+            if (code.fwStar) j++;
+            size_t prec_j = j;
+            if (code.precStar) j++;
+            size_t val_j = j;
+            if (code.ctype != '%') j++;
+
+            // Values given by * are only fetched when needed.
+            auto arg = [&](size_t k) {
+                if (k >= num_vals) {
+                    throw makeError(loc, "Not enough values to format: "
+                                         + jsonlang_unparse_number(num_vals));
+                }
+                return get(k);
+            };
+            auto fw = [&]() {
+                return code.fwStar ? arg(fw_j) : makeDouble(code.fw);
+            };
+            auto s = [&]() -> String {
+                if (code.ctype == '%')
+                    return U"%";
+                if (val_j >= num_vals) {
+                    throw makeError(loc, "Not enough values to format, got "
+                                         + jsonlang_unparse_number(num_vals));
+                }
+                Value val = get(val_j);
+                Value prec = code.precStar ? makeNull()
+                           : code.hasPrec ? makeDouble(code.prec) : makeNull();
+                bool uses_prec = code.ctype != 's' && code.ctype != 'c';
+                if (code.precStar && uses_prec)
+                    prec = arg(prec_j);
+                Value w = code.zero && !code.left && uses_prec ? fw() : makeDouble(0);
+                return formatCode(loc, val, code, w, prec, jsonlang_unparse_number(val_j));
+            };
+            if (code.left) {
+                String v = s();
+                r += formatPad(loc, v, formatWidth(loc, fw()), U' ', true);
+            } else {
+                double w = formatWidth(loc, fw());
+                r += formatPad(loc, s(), w, U' ', false);
+            }
+        }
+        if (j < num_vals) {
+            throw makeError(loc, "Too many values to format: " + jsonlang_unparse_number(num_vals)
+                                 + ", expected " + jsonlang_unparse_number(j));
+        }
+        return r;
+    }
+
+    const AST *builtinFormat(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        if (args[0].t != Value::STRING) {
+            throw makeError(loc, "std.format first parameter should be a string, got "
+                                 + std_type_str(args[0]));
+        }
+        scratch = makeString(format(loc, static_cast<HeapString*>(args[0].v.h), args[1]));
+        return nullptr;
+    }
+
+    const AST *builtinMod(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        if (args[0].t == Value::DOUBLE && args[1].t == Value::DOUBLE)
+            return builtinModulo(loc, args);
+        if (args[0].t == Value::STRING) {
+            scratch = makeString(format(loc, static_cast<HeapString*>(args[0].v.h), args[1]));
+            return nullptr;
+        }
+        throw makeError(loc, "Operator % cannot be used on types " + std_type_str(args[0])
+                             + " and " + std_type_str(args[1]) + ".");
+    }
+
+    /** The elements of a builtin's array parameter, which like the std.jsonlang versions of
+     * the sort and set functions may also be a string, taken as its characters.
+     *
+     * \param name Which parameter, for errors, e.g. "std.sort first".
+     * \param root Where to keep an array made from a string alive, e.g. a spare value in the
+     * builtin's frame.
+     */
+    HeapArray *arrayOrChars(const LocationRange &loc, const std::string &name, const Value &v,
+                            Value &root)
+    {
+        if (v.t == Value::STRING) {
+            builtinStringChars(loc, {v});
+            root = scratch;
+            return static_cast<HeapArray*>(scratch.v.h);
+        }
+        if (v.t != Value::ARRAY) {
+            throw makeError(loc, name + " parameter should be an array, got " + std_type_str(v));
+        }
+        return static_cast<HeapArray*>(v.v.h);
+    }
+
+    /** Order two values with the given operator (< or <=), which like the interpreter only
+     * supports numbers and strings.
+     *
+     * \returns A negative number, 0, or a positive number as a is less than, equal to or
+     * greater than b.
+     */
+    int compareValues(const LocationRange &loc, BinaryOp op, const Value &a, const Value &b)
+    {
+        if (a.t != b.t) {
+            throw makeError(loc, "Binary operator " + bop_string(op) + " requires matching "
+                                 "types, got " + type_str(a) + " and " + type_str(b) + ".");
+        }
+        switch (a.t) {
+            case Value::DOUBLE:
+            return a.v.d < b.v.d ? -1 : a.v.d > b.v.d ? 1 : 0;
+
+            case Value::STRING:
+            return static_cast<HeapString*>(a.v.h)->value().compare(
+                static_cast<HeapString*>(b.v.h)->value());
 
             case Value::ARRAY:
-            scratch = makeString(U"array");
-            return nullptr;
+            throw makeError(loc, "Binary operator " + bop_string(op)
+                                 + " does not operate on arrays.");
+
+            case Value::BOOLEAN:
+            throw makeError(loc, "Binary operator " + bop_string(op)
+                                 + " does not operate on booleans.");
 
             case Value::FUNCTION:
-            scratch = makeString(U"function");
-            return nullptr;
+            throw makeError(loc, "Binary operator " + bop_string(op)
+                                 + " does not operate on functions.");
 
-            case Value::OBJECT:
-            scratch = makeString(U"object");
-            return nullptr;
+            case Value::NULL_TYPE:
+            throw makeError(loc, "Binary operator " + bop_string(op)
+                                 + " does not operate on null.");
 
-            case Value::STRING:
-            scratch = makeString(U"string");
-            return nullptr;
+            case Value::OBJECT:
+            throw makeError(loc, "Binary operator " + bop_string(op)
+                                 + " does not operate on objects.");
         }
-        return nullptr;  // Quiet, compiler.
+        return 0;  // Quiet, compiler.
     }
 
-    const AST *builtinFilter(const LocationRange &loc, const std::vector<Value> &args)
+    /** Sort the elements of arr with a stable merge sort.
+     *
+     * All the elements are forced first, in order, unless there are fewer than two.
+     */
+    std::vector<HeapThunk*> sort(const LocationRange &loc, const HeapArray *arr)
     {
-        Frame &f = stack.top();
-        validateBuiltinArgs(loc, "filter", args, {Value::FUNCTION, Value::ARRAY});
-        auto *func = static_cast<HeapClosure*>(args[0].v.h);
-        auto *arr = static_cast<HeapArray*>(args[1].v.h);
-        if (func->params.size() != 1) {
-            throw makeError(loc, "filter function takes 1 parameter.");
-        }
-        if (arr->elements.size() == 0) {
-            scratch = makeArray({});
-        } else {
-            f.kind = FRAME_BUILTIN_FILTER;
-            f.val = args[0];
-            f.val2 = args[1];
-            f.thunks.clear();
-            f.elementId = 0;
-
-            auto *thunk = arr->elements[f.elementId];
-            BindingFrame bindings = func->upValues;
-            bindings[func->params[0].id] = thunk;
-            stack.newCall(loc, func, func->self, func->offset, bindings);
-            return func->body;
-        }
-        return nullptr;
+        std::vector<HeapThunk*> elements = arr->elements;
+        if (elements.size() < 2)
+            return elements;
+        for (auto *th : elements)
+            forceThunk(loc, th);
+        std::stable_sort(elements.begin(), elements.end(),
+                         [&](HeapThunk *a, HeapThunk *b) {
+                             return compareValues(loc, BOP_LESS_EQ, a->content, b->content) < 0;
+                         });
+        return elements;
     }
 
-    const AST *builtinObjectHasEx(const LocationRange &loc, const std::vector<Value> &args)
+    /** Drop the consecutive duplicates (according to ==) from the elements. */
+    std::vector<HeapThunk*> uniq(const LocationRange &loc,
+                                 const std::vector<HeapThunk*> &elements)
     {
-        validateBuiltinArgs(loc, "objectHasEx", args,
-                            {Value::OBJECT, Value::STRING,
-                             Value::BOOLEAN});
-        const auto *obj = static_cast<const HeapObject*>(args[0].v.h);
-        const auto *str = static_cast<const HeapString*>(args[1].v.h);
-        bool include_hidden = args[2].v.b;
-        bool found = false;
-        for (const auto &field : objectFields(obj, !include_hidden)) {
-            if (field->name == str->value) {
-                found = true;
-                break;
+        std::vector<HeapThunk*> r;
+        for (auto *th : elements) {
+            if (r.size() > 0) {
+                // Both are elements of arrays that are alive in the builtin's frame.
+                Value last = forceThunk(loc, r.back());
+                if (equals(loc, last, forceThunk(loc, th)))
+                    continue;
             }
+            r.push_back(th);
         }
-        scratch = makeBoolean(found);
-        return nullptr;
+        return r;
     }
 
-    const AST *builtinLength(const LocationRange &loc, const std::vector<Value> &args)
+    const AST *builtinSort(const LocationRange &loc, const std::vector<Value> &args)
     {
-        if (args.size() != 1) {
-            throw makeError(loc, "length takes 1 parameter.");
-        }
-        HeapEntity *e = args[0].v.h;
-        switch (args[0].t) {
-            case Value::OBJECT: {
-                auto fields = objectFields(static_cast<HeapObject*>(e), true);
-                scratch = makeDouble(fields.size());
-            } break;
-
-            case Value::ARRAY:
-            scratch = makeDouble(static_cast<HeapArray*>(e)->elements.size());
-            break;
+        scratch = makeArray(sort(loc, arrayOrChars(loc, "std.sort first", args[0], stack.top().val2)));
+        return nullptr;
+    }
 
-            case Value::STRING:
-            scratch = makeDouble(static_cast<HeapString*>(e)->value.length());
-            break;
+    const AST *builtinUniq(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        auto *arr = arrayOrChars(loc, "std.uniq first", args[0], stack.top().val2);
+        scratch = makeArray(uniq(loc, arr->elements));
+        return nullptr;
+    }
 
-            case Value::FUNCTION:
-            scratch = makeDouble(static_cast<HeapClosure*>(e)->params.size());
-            break;
+    const AST *builtinSet(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        auto *arr = arrayOrChars(loc, "std.set first", args[0], stack.top().val2);
+        scratch = makeArray(uniq(loc, sort(loc, arr)));
+        return nullptr;
+    }
 
-            default:
-            throw makeError(loc,
-                            "length operates on strings, objects, "
-                            "and arrays, got " + type_str(args[0]));
+    /** Binary search for x in a set (a sorted array without duplicates). */
+    const AST *builtinSetMember(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        const auto &elements = arrayOrChars(loc, "std.setMember second", args[1], stack.top().val2)->elements;
+        size_t begin = 0, end = elements.size();
+        while (begin < end) {
+            size_t mid = begin + (end - begin) / 2;
+            Value v = forceThunk(loc, elements[mid]);
+            if (equals(loc, args[0], v)) {
+                scratch = makeBoolean(true);
+                return nullptr;
+            }
+            if (compareValues(loc, BOP_LESS, args[0], v) < 0) {
+                end = mid;
+            } else {
+                begin = mid + 1;
+            }
         }
+        scratch = makeBoolean(false);
         return nullptr;
     }
 
-    const AST *builtinObjectFieldsEx(const LocationRange &loc, const std::vector<Value> &args)
+    const AST *builtinSetUnion(const LocationRange &loc, const std::vector<Value> &args)
     {
-        validateBuiltinArgs(loc, "objectFieldsEx", args,
-                            {Value::OBJECT, Value::BOOLEAN});
-        const auto *obj = static_cast<HeapObject*>(args[0].v.h);
-        bool include_hidden = args[1].v.b;
-        // Stash in a set first to sort them.
-        std::set<String> fields;
-        for (const auto &field : objectFields(obj, !include_hidden)) {
-            fields.insert(field->name);
-        }
-        scratch = makeArray({});
-        auto &elements = static_cast<HeapArray*>(scratch.v.h)->elements;
-        for (const auto &field : fields) {
-            auto *th = makeHeap<HeapThunk>(idArrayElement, nullptr, 0, nullptr);
-            elements.push_back(th);
-            th->fill(makeString(field));
-        }
+        // The values of the builtin's frame are only needed until the arrays are joined.
+        auto *a = arrayOrChars(loc, "std.setUnion first", args[0], stack.top().val);
+        auto *b = arrayOrChars(loc, "std.setUnion second", args[1], stack.top().val2);
+        std::vector<HeapThunk*> elements = a->elements;
+        elements.insert(elements.end(), b->elements.begin(), b->elements.end());
+        scratch = makeArray(elements);
+        stack.top().val2 = scratch;
+        scratch = makeArray(uniq(loc, sort(loc, static_cast<HeapArray*>(scratch.v.h))));
         return nullptr;
     }
 
-    const AST *builtinCodepoint(const LocationRange &loc, const std::vector<Value> &args)
+    /** Shared by std.setInter and std.setDiff, which walk both sets in order. */
+    void setInterOrDiff(const LocationRange &loc, const std::vector<Value> &args, bool diff)
     {
-        validateBuiltinArgs(loc, "codepoint", args, {Value::STRING});
-        const String &str =
-            static_cast<HeapString*>(args[0].v.h)->value;
-        if (str.length() != 1) {
-            std::stringstream ss;
-            ss << "codepoint takes a string of length 1, got length "
-               << str.length();
-            throw makeError(loc, ss.str());
+        std::string name = diff ? "std.setDiff" : "std.setInter";
+        // The builtin's frame is ours until we return.
+        const auto &a = arrayOrChars(loc, name + " first", args[0], stack.top().val)->elements;
+        const auto &b = arrayOrChars(loc, name + " second", args[1], stack.top().val2)->elements;
+        std::vector<HeapThunk*> r;
+        size_t i = 0, j = 0;
+        while (i < a.size()) {
+            if (j >= b.size()) {
+                if (!diff) break;
+                r.push_back(a[i++]);
+                continue;
+            }
+            Value x = forceThunk(loc, a[i]);
+            Value y = forceThunk(loc, b[j]);
+            if (equals(loc, x, y)) {
+                if (!diff) r.push_back(a[i]);
+                i++;
+                j++;
+            } else if (compareValues(loc, BOP_LESS, x, y) < 0) {
+                if (diff) r.push_back(a[i]);
+                i++;
+            } else {
+                j++;
+            }
         }
-        char32_t c = static_cast<HeapString*>(args[0].v.h)->value[0];
-        scratch = makeDouble((unsigned long)(c));
+        scratch = makeArray(r);
+    }
+
+    const AST *builtinSetInter(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        setInterOrDiff(loc, args, false);
         return nullptr;
     }
 
-    const AST *builtinChar(const LocationRange &loc, const std::vector<Value> &args)
+    const AST *builtinSetDiff(const LocationRange &loc, const std::vector<Value> &args)
     {
-        validateBuiltinArgs(loc, "char", args, {Value::DOUBLE});
-        long l = long(args[0].v.d);
-        if (l < 0) {
-            std::stringstream ss;
-            ss << "Codepoints must be >= 0, got " << l;
-            throw makeError(loc, ss.str());
-        }
-        if (l >= JSONLANG_CODEPOINT_MAX) {
-            std::stringstream ss;
-            ss << "Invalid unicode codepoint, got " << l;
-            throw makeError(loc, ss.str());
-        }
-        char32_t c = l;
-        scratch = makeString(String(&c, 1));
+        setInterOrDiff(loc, args, true);
         return nullptr;
     }
 
@@ -1434,7 +3830,7 @@ class Interpreter {
     {
         validateBuiltinArgs(loc, "extVar", args, {Value::STRING});
         const String &var =
-            static_cast<HeapString*>(args[0].v.h)->value;
+            static_cast<HeapString*>(args[0].v.h)->value();
         std::string var8 = encode_utf8(var);
         auto it = externalVars.find(var8);
         if (it == externalVars.end()) {
@@ -1478,8 +3874,8 @@ class Interpreter {
             break;
 
             case Value::STRING:
-            r = static_cast<HeapString*>(args[0].v.h)->value
-              == static_cast<HeapString*>(args[1].v.h)->value;
+            r = static_cast<HeapString*>(args[0].v.h)->value()
+              == static_cast<HeapString*>(args[1].v.h)->value();
             break;
 
             case Value::NULL_TYPE:
@@ -1499,11 +3895,186 @@ class Interpreter {
         return nullptr;
     }
 
+    /** Combine a hash into a running hash (as in boost::hash_combine). */
+    static void hashCombine(size_t &h, size_t v)
+    {
+        h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+
+    /** Compute the structural hash of a value, if it can be done without evaluating anything.
+     *
+     * Values that are equal according to std.equals have the same hash.  Arrays can only be
+     * hashed once all of their elements have been forced, and objects only if their fields are
+     * already values, i.e. objects made from JSON.  Functions cannot be hashed.  The hashes of
+     * arrays and objects are cached.
+     *
+     * \param v The value to hash.
+     * \param h Receives the hash.
+     * \returns false if the value cannot be hashed (yet).
+     */
+    bool structuralHash(const Value &v, size_t &h)
+    {
+        switch (v.t) {
+            case Value::NULL_TYPE:
+            h = 0;
+            return true;
+
+            case Value::BOOLEAN:
+            h = v.v.b ? 1 : 2;
+            return true;
+
+            case Value::DOUBLE:
+            // Make sure -0 and 0 collide, since they are equal.
+            h = std::hash<double>()(v.v.d == 0 ? 0.0 : v.v.d);
+            return true;
+
+            case Value::STRING:
+            h = static_cast<const HeapString*>(v.v.h)->hash();
+            return true;
+
+            case Value::FUNCTION:
+            return false;
+
+            case Value::ARRAY: {
+                auto *arr = static_cast<HeapArray*>(v.v.h);
+                if (!arr->hashed) {
+                    size_t r = arr->elements.size();
+                    for (const auto *th : arr->elements) {
+                        size_t el_h;
+                        if (!th->filled || !structuralHash(th->content, el_h)) return false;
+                        hashCombine(r, el_h);
+                    }
+                    arr->hash = r;
+                    arr->hashed = true;
+                }
+                h = arr->hash;
+                return true;
+            }
+
+            case Value::OBJECT: {
+                auto *obj = static_cast<HeapObject*>(v.v.h);
+                if (!obj->hashed) {
+                    auto *comp = dynamic_cast<HeapComprehensionObject*>(obj);
+                    if (comp == nullptr || comp->value != jsonObjVar) return false;
+                    size_t r = comp->compValues.size();
+                    for (const auto &pair : comp->compValues) {
+                        size_t field_h;
+                        const HeapThunk *th = pair.second;
+                        if (!th->filled || !structuralHash(th->content, field_h)) return false;
+                        // The fields are ordered by identifier, which is the same for any two
+                        // objects with the same field names.
+                        hashCombine(r, std::hash<String>()(pair.first->name));
+                        hashCombine(r, field_h);
+                    }
+                    obj->hash = r;
+                    obj->hashed = true;
+                }
+                h = obj->hash;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Decide std.equals(a, b), if it can be done without evaluating anything.
+     *
+     * This short-cuts on types, lengths, pointers and hashes, and compares hashable values in
+     * full (they hold no unevaluated code).  It never raises an error, leaving that to the
+     * general case, e.g. for comparing functions.
+     *
+     * \returns 1 if a and b are equal, 0 if they are not, or -1 if it cannot be decided.
+     */
+    int knownEquals(const Value &a, const Value &b)
+    {
+        if (a.t != b.t) return 0;
+        switch (a.t) {
+            case Value::NULL_TYPE:
+            return 1;
+
+            case Value::BOOLEAN:
+            return a.v.b == b.v.b;
+
+            case Value::DOUBLE:
+            return a.v.d == b.v.d;
+
+            case Value::STRING: {
+                const auto *sa = static_cast<const HeapString*>(a.v.h);
+                const auto *sb = static_cast<const HeapString*>(b.v.h);
+                if (sa == sb) return 1;
+                if (sa->utf8 != nullptr && sb->utf8 != nullptr) {
+                    // Both still in UTF-8, e.g. the same file imported twice.
+                    return sa->utf8Length == sb->utf8Length
+                           && std::memcmp(sa->utf8->data(), sb->utf8->data(),
+                                          sa->utf8Length) == 0;
+                }
+                if (sa->value().length() != sb->value().length()) return 0;
+                if (sa->hash() != sb->hash()) return 0;
+                return sa->value() == sb->value();
+            }
+
+            case Value::FUNCTION:
+            return -1;
+
+            case Value::ARRAY: {
+                const auto *arr_a = static_cast<const HeapArray*>(a.v.h);
+                const auto *arr_b = static_cast<const HeapArray*>(b.v.h);
+                if (arr_a->elements.size() != arr_b->elements.size()) return 0;
+                size_t ha, hb;
+                if (!structuralHash(a, ha) || !structuralHash(b, hb)) return -1;
+                if (arr_a == arr_b) return 1;
+                if (ha != hb) return 0;
+                for (unsigned i = 0 ; i < arr_a->elements.size() ; ++i) {
+                    if (knownEquals(arr_a->elements[i]->content,
+                                    arr_b->elements[i]->content) != 1)
+                        return 0;
+                }
+                return 1;
+            }
+
+            case Value::OBJECT: {
+                size_t ha, hb;
+                if (!structuralHash(a, ha) || !structuralHash(b, hb)) return -1;
+                if (a.v.h == b.v.h) return 1;
+                if (ha != hb) return 0;
+                // Only objects made from JSON are hashable, see structuralHash.
+                const auto *obj_a = static_cast<const HeapComprehensionObject*>(a.v.h);
+                const auto *obj_b = static_cast<const HeapComprehensionObject*>(b.v.h);
+                const auto &fields_a = obj_a->compValues;
+                const auto &fields_b = obj_b->compValues;
+                if (fields_a.size() != fields_b.size()) return 0;
+                for (auto ia = fields_a.begin(), ib = fields_b.begin() ; ia != fields_a.end() ;
+                     ++ia, ++ib) {
+                    if (ia->first != ib->first) return 0;
+                    if (knownEquals(ia->second->content, ib->second->content) != 1) return 0;
+                }
+                return 1;
+            }
+        }
+        return -1;
+    }
+
+    /** Decide a == b from native code.
+     *
+     * Values that knownEquals cannot decide are compared by running a FRAME_EQUALS, which
+     * re-enters the interpreter and so clobbers scratch.
+     */
+    bool equals(const LocationRange &loc, const Value &a, const Value &b)
+    {
+        int known = knownEquals(a, b);
+        if (known >= 0)
+            return known == 1;
+        stack.newFrame(FRAME_EQUALS, loc);
+        stack.top().val = a;
+        stack.top().val2 = b;
+        evaluate(nullLiteral, stack.size() - 1);
+        return scratch.v.b;
+    }
+
     const AST *builtinNative(const LocationRange &loc, const std::vector<Value> &args)
     {
         validateBuiltinArgs(loc, "native", args, {Value::STRING});
 
-        std::string builtin_name = encode_utf8(static_cast<HeapString*>(args[0].v.h)->value);
+        std::string builtin_name = encode_utf8(static_cast<HeapString*>(args[0].v.h)->value());
 
         VmNativeCallbackMap::const_iterator nit = nativeCallbacks.find(builtin_name);
         if (nit == nativeCallbacks.end()) {
@@ -1515,6 +4086,90 @@ class Interpreter {
         return nullptr;
     }
 
+    const AST *builtinMemoize(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "memoize", args, {Value::FUNCTION});
+        auto *func = static_cast<HeapClosure*>(args[0].v.h);
+        if (func->body == nullptr) {
+            throw makeError(loc, "memoize cannot be applied to builtin function <"
+                                 + func->builtinName + ">");
+        }
+        if (func->memo != nullptr) {
+            scratch = args[0];
+            return nullptr;
+        }
+        scratch = makeClosure(func->upValues, func->self, func->offset, func->params,
+                              func->body);
+        static_cast<HeapClosure*>(scratch.v.h)->memo.reset(new HeapClosure::Memo());
+        return nullptr;
+    }
+
+    const AST *builtinMemoizeStats(const LocationRange &loc, const std::vector<Value> &args)
+    {
+        validateBuiltinArgs(loc, "memoizeStats", args, {Value::FUNCTION});
+        auto *func = static_cast<HeapClosure*>(args[0].v.h);
+        if (func->memo == nullptr) {
+            throw makeError(loc, "memoizeStats requires a function made by std.memoize");
+        }
+        const HeapClosure::Memo &memo = *func->memo;
+        scratch = makeObject<HeapComprehensionObject>(
+            nullptr, jsonObjVar, idJsonObjVar, BindingFrame{});
+        auto *obj = static_cast<HeapComprehensionObject*>(scratch.v.h);
+        std::map<String, double> stats = {
+            {U"hits", double(memo.hits)},
+            {U"misses", double(memo.misses)},
+            {U"size", double(memo.results.size())},
+        };
+        for (const auto &pair : stats) {
+            auto *thunk = makeHeap<HeapThunk>(idJsonObjVar, nullptr, 0, nullptr);
+            obj->compValues[alloc->makeIdentifier(pair.first)] = thunk;
+            thunk->fill(makeDouble(pair.second));
+        }
+        return nullptr;
+    }
+
+    /** Encode the arguments of a memoized call, to be used as the key of its cache.
+     *
+     * \param args The environment binding the function parameters, all of which are forced.
+     * \param params The parameters of the function, giving the order of the encoding.
+     * \param key Receives the encoding.
+     * \returns false if some argument is not a primitive, so the call cannot be cached.
+     */
+    bool memoKey(const HeapEnv *args, const HeapClosure::Params &params, std::string &key)
+    {
+        key.clear();
+        for (const auto &param : params) {
+            const Value &v = args->bindings.find(param.id)->second->content;
+            switch (v.t) {
+                case Value::NULL_TYPE:
+                key += 'n';
+                break;
+
+                case Value::BOOLEAN:
+                key += v.v.b ? 't' : 'f';
+                break;
+
+                case Value::DOUBLE:
+                key += 'd';
+                key.append(reinterpret_cast<const char*>(&v.v.d), sizeof(v.v.d));
+                break;
+
+                case Value::STRING: {
+                    const String &str = static_cast<const HeapString*>(v.v.h)->value();
+                    size_t sz = str.length();
+                    key += 's';
+                    key.append(reinterpret_cast<const char*>(&sz), sizeof(sz));
+                    key.append(reinterpret_cast<const char*>(str.data()),
+                               sz * sizeof(char32_t));
+                } break;
+
+                default:
+                return false;
+            }
+        }
+        return true;
+    }
+
     void jsonToHeap(const std::unique_ptr<JsonlangJsonValue> &v, Value &attach)
     {
         // In order to not anger the garbage collector, assign to attach immediately after
@@ -1549,7 +4204,7 @@ class Interpreter {
 
             case JsonlangJsonValue::OBJECT: {
                 attach = makeObject<HeapComprehensionObject>(
-                    BindingFrame{}, jsonObjVar, idJsonObjVar, BindingFrame{});
+                    nullptr, jsonObjVar, idJsonObjVar, BindingFrame{});
                 auto *obj = static_cast<HeapComprehensionObject*>(attach.v.h);
                 for (const auto &pair : v->fields) {
                     auto *thunk = makeHeap<HeapThunk>(idJsonObjVar, nullptr, 0, nullptr);
@@ -1620,13 +4275,47 @@ class Interpreter {
             auto *comp = static_cast<HeapComprehensionObject*>(found);
             auto it = comp->compValues.find(f);
             auto *th = it->second;
-            BindingFrame binds = comp->upValues;
-            binds[comp->id] = th;
-            stack.newCall(loc, comp, self, found_at, binds);
+            // Push the call first, so comp is reachable while the environment is allocated.
+            stack.newCall(loc, comp, self, found_at, nullptr);
+            stack.top().env = makeHeap<HeapEnv>(comp->upValues, BindingFrame{{comp->id, th}});
             return comp->value;
         }
     }
 
+    /** The result of the comparison made by a FRAME_EQUALS, i.e. inverted for !=.
+     *
+     * Only the outermost FRAME_EQUALS is the frame of the == or != itself.
+     */
+    bool equalsResult(const Frame &f, bool equal)
+    {
+        if (f.ast == nullptr) return equal;
+        return static_cast<const Binary*>(f.ast)->op == BOP_MANIFEST_UNEQUAL ? !equal : equal;
+    }
+
+    /** Get the i-th element / field of a value being compared by FRAME_EQUALS.
+     *
+     * \param loc The location of the comparison.
+     * \param v The array or object.
+     * \param extra The state of the FRAME_EQUALS, holding the sorted fields of objects.
+     * \param i The element, or the index into the sorted fields.
+     * \returns The AST to evaluate to get it, or nullptr if it is already in scratch.
+     */
+    const AST *equalsElement(const LocationRange &loc, const Value &v, const FrameExtra *extra,
+                             unsigned i)
+    {
+        if (v.t == Value::ARRAY) {
+            auto *th = static_cast<HeapArray*>(v.v.h)->elements[i];
+            if (th->filled) {
+                scratch = th->content;
+                return nullptr;
+            }
+            stack.newCall(loc, th, th->self, th->offset, th->upValues);
+            return th->body;
+        }
+        auto *obj = static_cast<HeapObject*>(v.v.h);
+        return objectIndex(loc, obj, extra->fields[i], 0);
+    }
+
     void runInvariants(const LocationRange &loc, HeapObject *self)
     {
         if (stack.alreadyExecutingInvariants(self)) return;
@@ -1634,7 +4323,7 @@ class Interpreter {
         unsigned counter = 0;
         unsigned initial_stack_size = stack.size();
         stack.newFrame(FRAME_INVARIANTS, loc);
-        std::vector<HeapThunk*> &thunks = stack.top().thunks;
+        std::vector<HeapThunk*> &thunks = stack.top().extra->thunks;
         objectInvariants(self, self, counter, thunks);
         if (thunks.size() == 0) {
             stack.pop();
@@ -1680,7 +4369,7 @@ class Interpreter {
                 auto &elements = static_cast<HeapArray*>(scratch.v.h)->elements;
                 for (const auto &el : ast.elements) {
                     auto *el_th = makeHeap<HeapThunk>(idArrayElement, self, offset, el.expr);
-                    el_th->upValues =  capture(el.expr->freeVariables);
+                    el_th->upValues = capture();
                     elements.push_back(el_th);
                 }
             } break;
@@ -1722,14 +4411,14 @@ class Interpreter {
                 const auto &ast = *static_cast<const Exec*>(ast_);
                 AST *expr = exec(ast.location, ast.file);
                 ast_ = expr;
-                stack.newCall(ast.location, nullptr, nullptr, 0, BindingFrame());
+                stack.newCall(ast.location, nullptr, nullptr, 0, nullptr);
                 goto recurse;
             } break;
             // lambda - e
 
             case AST_FUNCTION: {
                 const auto &ast = *static_cast<const Function*>(ast_);
-                auto env = capture(ast.freeVariables);
+                auto *env = capture();
                 HeapObject *self;
                 unsigned offset;
                 stack.getSelfBinding(self, offset);
@@ -1743,16 +4432,24 @@ class Interpreter {
 
             case AST_IMPORT: {
                 const auto &ast = *static_cast<const Import*>(ast_);
+                if (importJson(ast.location, ast.file)) break;
                 AST *expr = import(ast.location, ast.file);
                 ast_ = expr;
-                stack.newCall(ast.location, nullptr, nullptr, 0, BindingFrame());
+                stack.newCall(ast.location, nullptr, nullptr, 0, nullptr);
                 goto recurse;
             } break;
 
             case AST_IMPORTSTR: {
                 const auto &ast = *static_cast<const Importstr*>(ast_);
                 const ImportCacheValue *value = importString(ast.location, ast.file);
-                scratch = makeString(decode_utf8(value->content));
+                const char *bytes = value->content->data();
+                // As ever, the content ends at the first NUL.
+                size_t length = std::strlen(bytes);
+                if (utf8_round_trips(bytes, length)) {
+                    scratch = makeString(value->content, length);
+                } else {
+                    scratch = makeString(decode_utf8(bytes));
+                }
             } break;
 
             case AST_INDEX: {
@@ -1766,6 +4463,8 @@ class Interpreter {
                 const auto &ast = *static_cast<const Local*>(ast_);
                 stack.newFrame(FRAME_LOCAL, ast_);
                 Frame &f = stack.top();
+                // The new environment is rooted in the frame before anything else is allocated.
+                f.env = makeHeap<HeapEnv>(capture());
                 // First build all the thunks and bind them.
                 HeapObject *self;
                 unsigned offset;
@@ -1774,12 +4473,11 @@ class Interpreter {
                     // Note that these 2 lines must remain separate to avoid the GC running
                     // when bindings has a nullptr for key bind.first.
                     auto *th = makeHeap<HeapThunk>(bind.var, self, offset, bind.body);
-                    f.bindings[bind.var] = th;
+                    f.env->bindings[bind.var] = th;
                 }
                 // Now capture the environment (including the new thunks, to make cycles).
                 for (const auto &bind : ast.binds) {
-                    auto *thunk = f.bindings[bind.var];
-                    thunk->upValues = capture(bind.body->freeVariables);
+                    f.env->bindings[bind.var]->upValues = f.env;
                 }
                 ast_ = ast.body;
                 goto recurse;
@@ -1797,7 +4495,7 @@ class Interpreter {
 
             case AST_LITERAL_STRING: {
                 const auto &ast = *static_cast<const LiteralString*>(ast_);
-                scratch = makeString(ast.value);
+                scratch = makeInternedString(ast.value);
             } break;
 
             case AST_LITERAL_NULL: {
@@ -1807,14 +4505,13 @@ class Interpreter {
             case AST_DESUGARED_OBJECT: {
                 const auto &ast = *static_cast<const DesugaredObject*>(ast_);
                 if (ast.fields.empty()) {
-                    auto env = capture(ast.freeVariables);
+                    auto *env = capture();
                     std::map<const Identifier *, HeapSimpleObject::Field> fields;
                     scratch = makeObject<HeapSimpleObject>(env, fields, ast.asserts);
                 } else {
-                    auto env = capture(ast.freeVariables);
                     stack.newFrame(FRAME_OBJECT, ast_);
                     auto fit = ast.fields.begin();
-                    stack.top().fit = fit;
+                    stack.top().extra->fit = fit;
                     ast_ = fit->name;
                     goto recurse;
                 }
@@ -1924,10 +4621,10 @@ class Interpreter {
                         unsigned offset;
                         stack.getSelfBinding(self, offset);
                         auto *thunk = makeHeap<HeapThunk>(name_, self, offset, arg.expr);
-                        thunk->upValues = capture(arg.expr->freeVariables);
+                        thunk->upValues = capture();
                         // While making the thunks, keep them in a frame to avoid premature garbage
                         // collection.
-                        f.thunks.push_back(thunk);
+                        f.extra->thunks.push_back(thunk);
                         if (args.find(name) != args.end()) {
                             std::stringstream ss;
                             ss << "Binding parameter a second time: " << encode_utf8(name->name);
@@ -1946,7 +4643,7 @@ class Interpreter {
                     // default argument than raise an error.
 
                     // Raise errors for unbound params, create thunks (but don't fill in upvalues).
-                    // This is a subset of f.thunks, so will not get garbage collected.
+                    // This is a subset of f.extra->thunks, so will not get garbage collected.
                     std::vector<HeapThunk*> def_arg_thunks;
                     for (const auto &param : func->params) {
                         if (args.find(param.id) != args.end()) continue;
@@ -1962,13 +4659,15 @@ class Interpreter {
                         const Identifier *name_ = func->body == nullptr ? nullptr : param.id;
                         auto *thunk = makeHeap<HeapThunk>(name_, func->self, func->offset,
                                                           param.def);
-                        f.thunks.push_back(thunk);
+                        f.extra->thunks.push_back(thunk);
                         def_arg_thunks.push_back(thunk);
                         args[param.id] = thunk;
                     }
 
-                    BindingFrame up_values = func->upValues;
-                    up_values.insert(args.begin(), args.end());
+                    // Builtins never look at the environment unless there are default args.
+                    HeapEnv *up_values = nullptr;
+                    if (func->body != nullptr || def_arg_thunks.size() > 0)
+                        up_values = makeHeap<HeapEnv>(func->upValues, args);
 
                     // Fill in upvalues
                     for (HeapThunk *thunk : def_arg_thunks) {
@@ -1976,7 +4675,7 @@ class Interpreter {
                     }
 
                     // Cache these, because pop will invalidate them.
-                    std::vector<HeapThunk*> thunks_copy = f.thunks;
+                    std::vector<HeapThunk*> thunks_copy = f.extra->thunks;
 
                     stack.pop();
 
@@ -1985,8 +4684,15 @@ class Interpreter {
                         // Give nullptr for self because noone looking at this frame will
                         // attempt to bind to self (it's native code).
                         stack.newFrame(FRAME_BUILTIN_FORCE_THUNKS, f.ast);
-                        stack.top().thunks = thunks_copy;
+                        stack.top().extra->thunks = thunks_copy;
+                        stack.top().val = scratch;
+                        goto replaceframe;
+                    } else if (func->memo != nullptr) {
+                        // Memoized function, force the args to see if the result is cached.
+                        stack.newFrame(FRAME_MEMO_CALL, &ast);
                         stack.top().val = scratch;
+                        stack.top().env = up_values;
+                        stack.top().elementId = 0;
                         goto replaceframe;
                     } else {
                         // User defined function.
@@ -1999,7 +4705,7 @@ class Interpreter {
                                 goto recurse;
                             } else {
                                 // The check for args.size() > 0
-                                stack.top().thunks = thunks_copy;
+                                stack.attachExtra(stack.top()).thunks = thunks_copy;
                                 stack.top().val = scratch;
                                 goto replaceframe;
                             }
@@ -2054,12 +4760,11 @@ class Interpreter {
                     // Equality can be used when the types don't match.
                     switch (ast.op) {
                         case BOP_MANIFEST_EQUAL:
-                        std::cerr << "INTERNAL ERROR: Equals not desugared" << std::endl;
-                        abort();
-
                         case BOP_MANIFEST_UNEQUAL:
-                        std::cerr << "INTERNAL ERROR: Notequals not desugared" << std::endl;
-                        abort();
+                        stack.top().kind = FRAME_EQUALS;
+                        stack.top().val2 = rhs;
+                        stack.top().elementId = 0;
+                        goto replaceframe;
 
                         default:;
                     }
@@ -2202,9 +4907,9 @@ class Interpreter {
 
                         case Value::STRING: {
                             const String &lhs_str =
-                                static_cast<HeapString*>(lhs.v.h)->value;
+                                static_cast<HeapString*>(lhs.v.h)->value();
                             const String &rhs_str =
-                                static_cast<HeapString*>(rhs.v.h)->value;
+                                static_cast<HeapString*>(rhs.v.h)->value();
                             switch (ast.op) {
                                 case BOP_PLUS:
                                 scratch = makeString(lhs_str + rhs_str);
@@ -2236,26 +4941,103 @@ class Interpreter {
                     }
                 } break;
 
-                case FRAME_BUILTIN_FILTER: {
+                case FRAME_BUILTIN_FILTER:
+                case FRAME_BUILTIN_FILTER_MAP: {
                     const auto &ast = *static_cast<const Apply*>(f.ast);
-                    auto *func = static_cast<HeapClosure*>(f.val.v.h);
                     auto *arr = static_cast<HeapArray*>(f.val2.v.h);
                     if (scratch.t != Value::BOOLEAN) {
                         throw makeError(ast.location,
                                         "filter function must return boolean, got: "
                                         + type_str(scratch));
                     }
-                    if (scratch.v.b) f.thunks.push_back(arr->elements[f.elementId]);
-                    f.elementId++;
-                    // Iterate through arr, calling the function on each.
+                    if (scratch.v.b) f.extra->thunks.push_back(arr->elements[f.elementId]);
+                    f.elementId++;
+                    // Iterate through arr, calling the function on each.
+                    if (f.elementId == arr->elements.size()) {
+                        if (f.kind == FRAME_BUILTIN_FILTER) {
+                            scratch = makeArray(f.extra->thunks);
+                        } else {
+                            const auto &kept = f.extra->thunks;
+                            scratch = makeArray(std::vector<HeapThunk*>(kept.begin() + 1,
+                                                                        kept.end()));
+                            mapElements(kept[0], static_cast<HeapArray*>(scratch.v.h));
+                        }
+                    } else {
+                        ast_ = callFunction(ast, f.val, {arr->elements[f.elementId]});
+                        goto recurse;
+                    }
+                } break;
+
+                case FRAME_BUILTIN_FLATTEN_ARRAYS: {
+                    const auto &ast = *static_cast<const Apply*>(f.ast);
+                    auto *arrs = static_cast<HeapArray*>(f.val2.v.h);
+                    for ( ; f.elementId < arrs->elements.size() ; ++f.elementId) {
+                        HeapThunk *th = arrs->elements[f.elementId];
+                        if (!th->filled) {
+                            stack.newCall(ast.location, th, th->self, th->offset, th->upValues);
+                            ast_ = th->body;
+                            goto recurse;
+                        }
+                        if (th->content.t != Value::ARRAY) {
+                            throw makeError(ast.location,
+                                            "Binary operator + requires matching types, got "
+                                            "array and " + type_str(th->content) + ".");
+                        }
+                        const auto &els = static_cast<HeapArray*>(th->content.v.h)->elements;
+                        f.extra->thunks.insert(f.extra->thunks.end(), els.begin(), els.end());
+                    }
+                    scratch = makeArray(f.extra->thunks);
+                } break;
+
+                case FRAME_BUILTIN_JOIN: {
+                    // As std.jsonlang did: the result is "" or [], plus sep and each element
+                    // that is not null in turn.
+                    // Coercing to a string can grow the stack, so f is not used after that.
+                    const auto &ast = *static_cast<const Apply*>(f.ast);
+                    auto *arr = static_cast<HeapArray*>(f.val2.v.h);
+                    const Value sep = f.val;
+                    FrameExtra *extra = f.extra;
+                    for (unsigned i = f.elementId ; i < arr->elements.size() ; ++i) {
+                        HeapThunk *th = arr->elements[i];
+                        if (!th->filled) {
+                            stack.top().elementId = i;
+                            stack.newCall(ast.location, th, th->self, th->offset, th->upValues);
+                            ast_ = th->body;
+                            goto recurse;
+                        }
+                        if (th->content.t == Value::NULL_TYPE) continue;
+                        if (!extra->joinFirst) joinAppend(ast.location, sep);
+                        extra->joinFirst = false;
+                        joinAppend(ast.location, th->content);
+                    }
+                    if (extra->joinString) {
+                        scratch = makeString(extra->str);
+                    } else {
+                        scratch = makeArray(extra->thunks);
+                    }
+                } break;
+
+                case FRAME_BUILTIN_FOLDL:
+                case FRAME_BUILTIN_FOLDR: {
+                    const auto &ast = *static_cast<const Apply*>(f.ast);
+                    auto *arr = static_cast<HeapArray*>(f.val2.v.h);
+                    // The first thunk holds the running value, initially the init argument.
+                    if (f.elementId > 0) {
+                        auto *running = makeHeap<HeapThunk>(nullptr, nullptr, 0, nullptr);
+                        running->fill(scratch);
+                        f.extra->thunks[0] = running;
+                    }
+                    HeapThunk *running = f.extra->thunks[0];
                     if (f.elementId == arr->elements.size()) {
-                        scratch = makeArray(f.thunks);
+                        scratch = running->content;
                     } else {
-                        auto *thunk = arr->elements[f.elementId];
-                        BindingFrame bindings = func->upValues;
-                        bindings[func->params[0].id] = thunk;
-                        stack.newCall(ast.location, func, func->self, func->offset, bindings);
-                        ast_ = func->body;
+                        unsigned i = f.elementId++;
+                        if (f.kind == FRAME_BUILTIN_FOLDL) {
+                            ast_ = callFunction(ast, f.val, {running, arr->elements[i]});
+                        } else {
+                            HeapThunk *el = arr->elements[arr->elements.size() - 1 - i];
+                            ast_ = callFunction(ast, f.val, {el, running});
+                        }
                         goto recurse;
                     }
                 } break;
@@ -2263,12 +5045,12 @@ class Interpreter {
                 case FRAME_BUILTIN_FORCE_THUNKS: {
                     const auto &ast = *static_cast<const Apply*>(f.ast);
                     auto *func = static_cast<HeapClosure*>(f.val.v.h);
-                    if (f.elementId == f.thunks.size()) {
+                    if (f.elementId == f.extra->thunks.size()) {
                         // All thunks forced, now the builtin implementations.
                         const LocationRange &loc = ast.location;
                         const std::string &builtin_name = func->builtinName;
                         std::vector<Value> args;
-                        for (auto *th : f.thunks) {
+                        for (auto *th : f.extra->thunks) {
                             args.push_back(th->content);
                         }
                         BuiltinMap::const_iterator bit = builtins.find(builtin_name);
@@ -2290,7 +5072,7 @@ class Interpreter {
                                 case Value::STRING:
                                 args2.push_back(JsonlangJsonValue{
                                     JsonlangJsonValue::STRING,
-                                    encode_utf8(static_cast<HeapString*>(arg.v.h)->value),
+                                    encode_utf8(static_cast<HeapString*>(arg.v.h)->value()),
                                     0,
                                     std::vector<std::unique_ptr<JsonlangJsonValue>>{},
                                     std::map<std::string, std::unique_ptr<JsonlangJsonValue>>{},
@@ -2360,12 +5142,13 @@ class Interpreter {
 
                     } else {
                         // Not all arguments forced yet.
-                        HeapThunk *th = f.thunks[f.elementId++];
+                        HeapThunk *th = f.extra->thunks[f.elementId++];
                         if (!th->filled) {
                             stack.newCall(ast.location, th, th->self, th->offset, th->upValues);
                             ast_ = th->body;
                             goto recurse;
                         }
+                        goto replaceframe;
                     }
                 } break;
 
@@ -2374,20 +5157,20 @@ class Interpreter {
                         // If we called a thunk, cache result.
                         thunk->fill(scratch);
                     } else if (auto *closure = dynamic_cast<HeapClosure*>(f.context)) {
-                        if (f.elementId < f.thunks.size()) {
+                        if (f.elementId < f.numThunks()) {
                             // If tailstrict, force thunks
-                            HeapThunk *th = f.thunks[f.elementId++];
+                            HeapThunk *th = f.extra->thunks[f.elementId++];
                             if (!th->filled) {
                                 stack.newCall(f.location, th,
                                               th->self, th->offset, th->upValues);
                                 ast_ = th->body;
                                 goto recurse;
                             }
-                        } else if (f.thunks.size() == 0) {
+                        } else if (f.numThunks() == 0) {
                             // Body has now been executed
                         } else {
                             // Execute the body
-                            f.thunks.clear();
+                            f.extra->thunks.clear();
                             f.elementId = 0;
                             ast_ = closure->body;
                             goto recurse;
@@ -2396,12 +5179,99 @@ class Interpreter {
                     // Result of call is in scratch, just pop.
                 } break;
 
+                case FRAME_EQUALS: {
+                    unsigned num_elements;
+                    if (f.elementId == 0) {
+                        // Compare the values themselves.
+                        int known = knownEquals(f.val, f.val2);
+                        if (known >= 0) {
+                            scratch = makeBoolean(equalsResult(f, known == 1));
+                            break;
+                        }
+                        if (f.val.t == Value::FUNCTION) {
+                            throw makeError(f.location, "Cannot test equality of functions");
+                        }
+                        if (f.val.t == Value::ARRAY) {
+                            num_elements = static_cast<HeapArray*>(f.val.v.h)->elements.size();
+                        } else {
+                            auto *obj_a = static_cast<HeapObject*>(f.val.v.h);
+                            auto *obj_b = static_cast<HeapObject*>(f.val2.v.h);
+                            auto fields = objectFields(obj_a, true);
+                            if (fields != objectFields(obj_b, true)) {
+                                scratch = makeBoolean(equalsResult(f, false));
+                                break;
+                            }
+                            if (fields.size() == 0) {
+                                scratch = makeBoolean(equalsResult(f, true));
+                                break;
+                            }
+                            auto &sorted = stack.attachExtra(f).fields;
+                            sorted.assign(fields.begin(), fields.end());
+                            std::sort(sorted.begin(), sorted.end(),
+                                      [](const Identifier *a, const Identifier *b) {
+                                          return a->name < b->name;
+                                      });
+                            num_elements = sorted.size();
+                            // Indexing an object checks its invariants.  This may re-enter
+                            // the interpreter, which invalidates f.
+                            LocationRange loc = f.location;
+                            runInvariants(loc, obj_a);
+                            runInvariants(loc, obj_b);
+                        }
+                    } else {
+                        // The last pair of elements / fields have been compared.
+                        if (!scratch.v.b) {
+                            scratch = makeBoolean(equalsResult(f, false));
+                            break;
+                        }
+                        num_elements = f.val.t == Value::ARRAY
+                                     ? static_cast<HeapArray*>(f.val.v.h)->elements.size()
+                                     : f.extra->fields.size();
+                    }
+                    Frame &f2 = stack.top();
+                    if (f2.elementId == num_elements) {
+                        scratch = makeBoolean(equalsResult(f2, true));
+                        break;
+                    }
+                    // Evaluate the next element / field of val.
+                    f2.kind = FRAME_EQUALS_LEFT;
+                    const AST *body = equalsElement(f2.location, f2.val, f2.extra, f2.elementId);
+                    if (body != nullptr) {
+                        ast_ = body;
+                        goto recurse;
+                    }
+                    goto replaceframe;
+                } break;
+
+                case FRAME_EQUALS_LEFT: {
+                    // Keep the element of val (in scratch) while evaluating that of val2.
+                    f.kind = FRAME_EQUALS;
+                    unsigned i = f.elementId++;
+                    Value other = f.val2;
+                    const FrameExtra *extra = f.extra;
+                    stack.newFrame(FRAME_EQUALS_RIGHT, f.location);
+                    stack.top().val = scratch;
+                    const AST *body = equalsElement(stack.top().location, other, extra, i);
+                    if (body != nullptr) {
+                        ast_ = body;
+                        goto recurse;
+                    }
+                    goto replaceframe;
+                } break;
+
+                case FRAME_EQUALS_RIGHT: {
+                    f.val2 = scratch;
+                    f.kind = FRAME_EQUALS;
+                    f.elementId = 0;
+                    goto replaceframe;
+                } break;
+
                 case FRAME_ERROR: {
                     const auto &ast = *static_cast<const Error*>(f.ast);
                     if (scratch.t != Value::STRING)
                         throw makeError(ast.location, "Error message must be string, got " +
                                                       type_str(scratch) + ".");
-                    std::string msg = encode_utf8(static_cast<HeapString*>(scratch.v.h)->value);
+                    std::string msg = encode_utf8(static_cast<HeapString*>(scratch.v.h)->value());
                     throw makeError(ast.location, msg);
                 } break;
 
@@ -2433,7 +5303,7 @@ class Interpreter {
                     }
 
                     const String &index_name =
-                        static_cast<HeapString*>(scratch.v.h)->value;
+                        static_cast<HeapString*>(scratch.v.h)->value();
                     auto *fid = alloc->makeIdentifier(index_name);
                     stack.pop();
                     ast_ = objectIndex(ast.location, self, fid, offset);
@@ -2476,7 +5346,7 @@ class Interpreter {
                                             + type_str(scratch) + ".");
                         }
                         const String &index_name =
-                            static_cast<HeapString*>(scratch.v.h)->value;
+                            static_cast<HeapString*>(scratch.v.h)->value();
                         auto *fid = alloc->makeIdentifier(index_name);
                         stack.pop();
                         ast_ = objectIndex(ast.location, obj, fid, 0);
@@ -2489,7 +5359,7 @@ class Interpreter {
                                             "String index must be a number, got "
                                             + type_str(scratch) + ".");
                         }
-                        long sz = obj->value.length();
+                        long sz = obj->value().length();
                         long i = (long)scratch.v.d;
                         if (i < 0 || i >= sz) {
                             std::stringstream ss;
@@ -2497,7 +5367,7 @@ class Interpreter {
                                << " not within [0, " << sz << ")";
                             throw makeError(ast.location, ss.str());
                         }
-                        char32_t ch[] = {obj->value[i], U'\0'};
+                        char32_t ch[] = {obj->value()[i], U'\0'};
                         scratch = makeString(ch);
                     } else {
                         std::cerr << "INTERNAL ERROR: Not object / array / string." << std::endl;
@@ -2523,9 +5393,9 @@ class Interpreter {
                             Frame &f2 = stack.top();
                             f2.self = self;
                             unsigned counter = 0;
-                            objectInvariants(self, self, counter, f2.thunks);
-                            if (f2.thunks.size() > 0) {
-                                auto *thunk = f2.thunks[0];
+                            objectInvariants(self, self, counter, f2.extra->thunks);
+                            if (f2.extra->thunks.size() > 0) {
+                                auto *thunk = f2.extra->thunks[0];
                                 f2.elementId = 1;
                                 stack.newCall(ast.location, thunk,
                                               thunk->self, thunk->offset, thunk->upValues);
@@ -2539,7 +5409,7 @@ class Interpreter {
                 } break;
 
                 case FRAME_INVARIANTS: {
-                    if (f.elementId >= f.thunks.size()) {
+                    if (f.elementId >= f.extra->thunks.size()) {
                         if (stack.size() == initial_stack_size + 1) {
                             // Just pop, evaluate was invoked by runInvariants.
                             break;
@@ -2550,7 +5420,7 @@ class Interpreter {
                         ast_ = ast.index;
                         goto recurse;
                     }
-                    auto *thunk = f.thunks[f.elementId++];
+                    auto *thunk = f.extra->thunks[f.elementId++];
                     stack.newCall(f.location, thunk,
                                   thunk->self, thunk->offset, thunk->upValues);
                     ast_ = thunk->body;
@@ -2561,29 +5431,77 @@ class Interpreter {
                     // Result of execution is in scratch already.
                 } break;
 
+                case FRAME_MEMO_CALL: {
+                    const auto &ast = *static_cast<const Apply*>(f.ast);
+                    auto *func = static_cast<HeapClosure*>(f.val.v.h);
+                    if (f.elementId < func->params.size()) {
+                        const auto *param_id = func->params[f.elementId++].id;
+                        HeapThunk *th = f.env->bindings.find(param_id)->second;
+                        if (!th->filled) {
+                            stack.newCall(ast.location, th, th->self, th->offset, th->upValues);
+                            ast_ = th->body;
+                            goto recurse;
+                        }
+                        goto replaceframe;
+                    }
+                    HeapClosure::Memo &memo = *func->memo;
+                    std::string key;
+                    bool cacheable = memoKey(f.env, func->params, key);
+                    if (cacheable) {
+                        auto it = memo.results.find(key);
+                        if (it != memo.results.end()) {
+                            memo.hits++;
+                            scratch = it->second;
+                            break;
+                        }
+                    }
+                    memo.misses++;
+                    // The arguments are only needed by the body now, and the frame must not
+                    // keep them in scope or the function would be named after its parameters
+                    // in stack traces.
+                    HeapEnv *up_values = f.env;
+                    f.env = nullptr;
+                    if (cacheable) {
+                        f.kind = FRAME_MEMO_RESULT;
+                        stack.attachExtra(f).memoKey = key;
+                    } else {
+                        stack.pop();
+                    }
+                    stack.newCall(ast.location, func, func->self, func->offset, up_values);
+                    ast_ = func->body;
+                    goto recurse;
+                } break;
+
+                case FRAME_MEMO_RESULT: {
+                    auto *func = static_cast<HeapClosure*>(f.val.v.h);
+                    func->memo->results[f.extra->memoKey] = scratch;
+                } break;
+
                 case FRAME_OBJECT: {
                     const auto &ast = *static_cast<const DesugaredObject*>(f.ast);
                     if (scratch.t != Value::NULL_TYPE) {
                         if (scratch.t != Value::STRING) {
                             throw makeError(ast.location, "Field name was not a string.");
                         }
-                        const auto &fname = static_cast<const HeapString*>(scratch.v.h)->value;
+                        const auto &fname = static_cast<const HeapString*>(scratch.v.h)->value();
                         const Identifier *fid = alloc->makeIdentifier(fname);
-                        if (f.objectFields.find(fid) != f.objectFields.end()) {
+                        auto &object_fields = f.extra->objectFields;
+                        if (object_fields.find(fid) != object_fields.end()) {
                             std::string msg = "Duplicate field name: \""
                                               + encode_utf8(fname) + "\"";
                             throw makeError(ast.location, msg);
                         }
-                        f.objectFields[fid].hide = f.fit->hide;
-                        f.objectFields[fid].body = f.fit->body;
+                        object_fields[fid].hide = f.extra->fit->hide;
+                        object_fields[fid].body = f.extra->fit->body;
                     }
-                    f.fit++;
-                    if (f.fit != ast.fields.end()) {
-                        ast_ = f.fit->name;
+                    f.extra->fit++;
+                    if (f.extra->fit != ast.fields.end()) {
+                        ast_ = f.extra->fit->name;
                         goto recurse;
                     } else {
-                        auto env = capture(ast.freeVariables);
-                        scratch = makeObject<HeapSimpleObject>(env, f.objectFields, ast.asserts);
+                        auto *env = capture();
+                        scratch = makeObject<HeapSimpleObject>(env, f.extra->objectFields,
+                                                                  ast.asserts);
                     }
                 } break;
 
@@ -2598,12 +5516,16 @@ class Interpreter {
                     const auto *arr = static_cast<const HeapArray*>(arr_v.v.h);
                     if (arr->elements.size() == 0) {
                         // Degenerate case.  Just create the object now.
-                        scratch = makeObject<HeapComprehensionObject>(BindingFrame{}, ast.value,
+                        auto *env = capture();
+                        scratch = makeObject<HeapComprehensionObject>(env, ast.value,
                                                                       ast.id, BindingFrame{});
                     } else {
                         f.kind = FRAME_OBJECT_COMP_ELEMENT;
                         f.val = scratch;
-                        f.bindings[ast.id] = arr->elements[0];
+                        // Each element gets its own environment, whose parent is the one the
+                        // object captures when it is complete.
+                        f.env = makeHeap<HeapEnv>(capture(),
+                                                  BindingFrame{{ast.id, arr->elements[0]}});
                         f.elementId = 0;
                         ast_ = ast.field;
                         goto recurse;
@@ -2618,21 +5540,22 @@ class Interpreter {
                         ss << "field must be string, got: " << type_str(scratch);
                         throw makeError(ast.location, ss.str());
                     }
-                    const auto &fname = static_cast<const HeapString*>(scratch.v.h)->value;
+                    const auto &fname = static_cast<const HeapString*>(scratch.v.h)->value();
                     const Identifier *fid = alloc->makeIdentifier(fname);
-                    if (f.elements.find(fid) != f.elements.end()) {
+                    auto &elements = f.extra->elements;
+                    if (elements.find(fid) != elements.end()) {
                         throw makeError(ast.location,
                                         "Duplicate field name: \"" + encode_utf8(fname) + "\"");
                     }
-                    f.elements[fid] = arr->elements[f.elementId];
+                    elements[fid] = arr->elements[f.elementId];
                     f.elementId++;
 
                     if (f.elementId == arr->elements.size()) {
-                        auto env = capture(ast.freeVariables);
-                        scratch = makeObject<HeapComprehensionObject>(env, ast.value,
-                                                                      ast.id, f.elements);
+                        scratch = makeObject<HeapComprehensionObject>(f.env->parent, ast.value,
+                                                                      ast.id, elements);
                     } else {
-                        f.bindings[ast.id] = arr->elements[f.elementId];
+                        auto *el = arr->elements[f.elementId];
+                        f.env = makeHeap<HeapEnv>(f.env->parent, BindingFrame{{ast.id, el}});
                         ast_ = ast.field;
                         goto recurse;
                     }
@@ -2644,13 +5567,13 @@ class Interpreter {
                     const Value &rhs = stack.top().val2;
                     String output;
                     if (lhs.t == Value::STRING) {
-                        output.append(static_cast<const HeapString*>(lhs.v.h)->value);
+                        output.append(static_cast<const HeapString*>(lhs.v.h)->value());
                     } else {
                         scratch = lhs;
                         output.append(toString(ast.left->location));
                     }
                     if (rhs.t == Value::STRING) {
-                        output.append(static_cast<const HeapString*>(rhs.v.h)->value);
+                        output.append(static_cast<const HeapString*>(rhs.v.h)->value());
                     } else {
                         scratch = rhs;
                         output.append(toString(ast.right->location));
@@ -2720,115 +5643,373 @@ class Interpreter {
      * \param multiline If true, will print objects and arrays in an indented fashion.
      */
     String manifestJson(const LocationRange &loc, bool multiline, const String &indent)
+    {
+        ManifestState state(MANIFEST_JSON, multiline, U"   ", indent);
+        manifestJson(loc, state);
+        return state.out;
+    }
+
+    /** Manifest the scratch value as the output of the program, in the given format, writing
+     * it to sink in chunks as it goes.
+     */
+    void manifestJson(const LocationRange &loc, VmOutputFormat format, VmOutput &sink)
+    {
+        if (format == VM_OUTPUT_CBOR || format == VM_OUTPUT_MSGPACK) {
+            BinaryEncoder enc(format);
+            manifestBinary(loc, enc, sink);
+            manifestBinaryFlush(enc, sink, true);
+            return;
+        }
+        bool compact = format == VM_OUTPUT_JSON_COMPACT;
+        ManifestState state(MANIFEST_JSON, !compact, compact ? U"" : U"   ", U"", &sink);
+        state.compact = compact;
+        manifestJson(loc, state);
+        manifestFlush(state, true);
+    }
+
+    /** Manifest the scratch value in a binary format, appending to enc.out and passing that on
+     * to sink a chunk at a time.
+     *
+     * This can trigger a garbage collection cycle, like manifestJson.
+     */
+    void manifestBinary(const LocationRange &loc, BinaryEncoder &enc, VmOutput &sink)
+    {
+        switch (scratch.t) {
+            case Value::ARRAY: {
+                HeapArray *arr = static_cast<HeapArray*>(scratch.v.h);
+                enc.array(arr->elements.size());
+                for (auto *thunk : arr->elements) {
+                    LocationRange tloc = thunk->body == nullptr
+                                       ? loc
+                                       : thunk->body->location;
+                    if (thunk->filled) {
+                        stack.newCall(loc, thunk, nullptr, 0, nullptr);
+                        // Keep arr alive when scratch is overwritten
+                        stack.top().val = scratch;
+                        scratch = thunk->content;
+                    } else {
+                        stack.newCall(loc, thunk, thunk->self, thunk->offset, thunk->upValues);
+                        // Keep arr alive when scratch is overwritten
+                        stack.top().val = scratch;
+                        evaluate(thunk->body, stack.size());
+                    }
+                    manifestBinary(tloc, enc, sink);
+                    // Restore scratch
+                    scratch = stack.top().val;
+                    stack.pop();
+                    manifestBinaryFlush(enc, sink, false);
+                }
+            }
+            break;
+
+            case Value::BOOLEAN:
+            enc.boolean(scratch.v.b);
+            break;
+
+            case Value::DOUBLE:
+            enc.number(scratch.v.d);
+            break;
+
+            case Value::FUNCTION:
+            throw makeError(loc, std::string("Couldn't manifest function in ") + enc.name()
+                                 + " output.");
+
+            case Value::NULL_TYPE:
+            enc.null();
+            break;
+
+            case Value::OBJECT: {
+                auto *obj = static_cast<HeapObject*>(scratch.v.h);
+                runInvariants(loc, obj);
+                auto fields = sortedFields(obj);
+                enc.map(fields.size());
+                for (const auto &f : fields) {
+                    // pushes FRAME_CALL
+                    const AST *body = objectIndex(loc, obj, f.second, 0);
+                    stack.top().val = scratch;
+                    evaluate(body, stack.size());
+                    enc.string(encode_utf8(f.first));
+                    manifestBinary(body->location, enc, sink);
+                    // Reset scratch so that the object we're manifesting doesn't
+                    // get GC'd.
+                    scratch = stack.top().val;
+                    stack.pop();
+                    manifestBinaryFlush(enc, sink, false);
+                }
+            }
+            break;
+
+            case Value::STRING: {
+                const auto *str = static_cast<HeapString*>(scratch.v.h);
+                if (str->utf8 != nullptr) {
+                    enc.string(str->utf8->data(), str->utf8Length);
+                } else {
+                    enc.string(encode_utf8(str->value()));
+                }
+            }
+            break;
+        }
+    }
+
+    /** Pass enc.out on to sink once it is big enough, or if forced. */
+    void manifestBinaryFlush(BinaryEncoder &enc, VmOutput &sink, bool force)
+    {
+        if (!force && enc.out.length() < MANIFEST_CHUNK_SIZE) return;
+        sink.write(enc.out.data(), enc.out.length());
+        enc.out.clear();
+    }
+
+    /** Pass state.out on to state.sink, if there is one, once it is big enough or if forced.
+     */
+    void manifestFlush(ManifestState &state, bool force)
+    {
+        if (state.sink == nullptr) return;
+        if (!force && state.out.length() < MANIFEST_CHUNK_SIZE) return;
+        state.utf8.clear();
+        encode_utf8(state.out, state.utf8);
+        state.out.clear();
+        state.sink->write(state.utf8.data(), state.utf8.length());
+    }
+
+    /** Manifest the scratch value in the given style, appending to state.out.
+     *
+     * This can trigger a garbage collection cycle, like manifestJson above.
+     */
+    void manifestJson(const LocationRange &loc, ManifestState &state)
     {
         // Printing fields means evaluating and binding them, which can trigger
         // garbage collection.
 
-        StringStream ss;
+        String &out = state.out;
         switch (scratch.t) {
             case Value::ARRAY: {
                 HeapArray *arr = static_cast<HeapArray*>(scratch.v.h);
-                if (arr->elements.size() == 0) {
-                    ss << U"[ ]";
-                } else {
-                    const char32_t *prefix = multiline ? U"[\n" : U"[";
-                    String indent2 = multiline ? indent + U"   " : indent;
-                    for (auto *thunk : arr->elements) {
-                        LocationRange tloc = thunk->body == nullptr
-                                           ? loc
-                                           : thunk->body->location;
-                        if (thunk->filled) {
-                            stack.newCall(loc, thunk, nullptr, 0, BindingFrame{});
-                            // Keep arr alive when scratch is overwritten
-                            stack.top().val = scratch;
-                            scratch = thunk->content;
-                        } else {
-                            stack.newCall(loc, thunk, thunk->self, thunk->offset, thunk->upValues);
-                            // Keep arr alive when scratch is overwritten
-                            stack.top().val = scratch;
-                            evaluate(thunk->body, stack.size());
-                        }
-                        auto element = manifestJson(tloc, multiline, indent2);
-                        // Restore scratch
-                        scratch = stack.top().val;
-                        stack.pop();
-                        ss << prefix << indent2 << element;
-                        prefix = multiline ? U",\n" : U", ";
+                if (arr->elements.size() == 0 && state.style == MANIFEST_JSON) {
+                    out += state.compact ? U"[]" : U"[ ]";
+                    break;
+                }
+                const char32_t *prefix = state.multiline ? U"[\n" : U"[";
+                const char32_t *separator = state.multiline ? U",\n"
+                                          : state.compact ? U"," : U", ";
+                size_t cindent_length = state.cindent.length();
+                if (state.multiline) state.cindent += state.indent;
+                for (unsigned long i = 0 ; i < arr->elements.size() ; ++i) {
+                    auto *thunk = arr->elements[i];
+                    LocationRange tloc = thunk->body == nullptr
+                                       ? loc
+                                       : thunk->body->location;
+                    if (thunk->filled) {
+                        stack.newCall(loc, thunk, nullptr, 0, nullptr);
+                        // Keep arr alive when scratch is overwritten
+                        stack.top().val = scratch;
+                        scratch = thunk->content;
+                    } else {
+                        stack.newCall(loc, thunk, thunk->self, thunk->offset, thunk->upValues);
+                        // Keep arr alive when scratch is overwritten
+                        stack.top().val = scratch;
+                        evaluate(thunk->body, stack.size());
                     }
-                    ss << (multiline ? U"\n" : U"") << indent << U"]";
+                    out += prefix;
+                    if (state.multiline) out += state.cindent;
+                    if (state.style == MANIFEST_JSON_EX) state.path.push_back({nullptr, i});
+                    manifestJson(tloc, state);
+                    if (state.style == MANIFEST_JSON_EX) state.path.pop_back();
+                    // Restore scratch
+                    scratch = stack.top().val;
+                    stack.pop();
+                    prefix = separator;
+                    manifestFlush(state, false);
                 }
+                // Only the std functions write empty arrays this way, e.g. [] in Python.
+                if (arr->elements.size() == 0) out += prefix;
+                state.cindent.resize(cindent_length);
+                if (state.multiline) {
+                    out += U"\n";
+                    out += state.cindent;
+                }
+                out += U"]";
             }
             break;
 
             case Value::BOOLEAN:
-            ss << (scratch.v.b ? U"true" : U"false");
+            if (state.style == MANIFEST_PYTHON) {
+                out += scratch.v.b ? U"True" : U"False";
+            } else {
+                out += scratch.v.b ? U"true" : U"false";
+            }
             break;
 
             case Value::DOUBLE:
-            ss << decode_utf8(jsonlang_unparse_number(scratch.v.d));
+            jsonlang_unparse_number(scratch.v.d, out);
             break;
 
             case Value::FUNCTION:
-            throw makeError(loc, "Couldn't manifest function in JSON output.");
+            switch (state.style) {
+                case MANIFEST_JSON:
+                throw makeError(loc, "Couldn't manifest function in JSON output.");
+
+                case MANIFEST_JSON_EX:
+                throw makeError(loc, "Tried to manifest function at " + manifestPath(state));
+
+                case MANIFEST_PYTHON:
+                throw makeError(loc, "cannot manifest function");
+            }
+            break;
 
             case Value::NULL_TYPE:
-            ss << U"null";
+            out += state.style == MANIFEST_PYTHON ? U"None" : U"null";
             break;
 
             case Value::OBJECT: {
                 auto *obj = static_cast<HeapObject*>(scratch.v.h);
-                runInvariants(loc, obj);
                 // Using std::map has the useful side-effect of ordering the fields
                 // alphabetically.
                 std::map<String, const Identifier*> fields;
                 for (const auto &f : objectFields(obj, true)) {
                     fields[f->name] = f;
                 }
-                if (fields.size() == 0) {
-                    ss << U"{ }";
-                } else {
-                    String indent2 = multiline ? indent + U"   " : indent;
-                    const char32_t *prefix = multiline ? U"{\n" : U"{";
-                    for (const auto &f : fields) {
-                        // pushes FRAME_CALL
-                        const AST *body = objectIndex(loc, obj, f.second, 0);
-                        stack.top().val = scratch;
-                        evaluate(body, stack.size());
-                        auto vstr = manifestJson(body->location, multiline, indent2);
-                        // Reset scratch so that the object we're manifesting doesn't
-                        // get GC'd.
-                        scratch = stack.top().val;
-                        stack.pop();
-                        ss << prefix << indent2 << U"\"" << f.first << U"\": " << vstr;
-                        prefix = multiline ? U",\n" : U", ";
+                // The std functions only index the object, and so check its invariants, when
+                // it has fields.
+                if (state.style == MANIFEST_JSON || fields.size() > 0) {
+                    runInvariants(loc, obj);
+                }
+                if (fields.size() == 0 && state.style == MANIFEST_JSON) {
+                    out += state.compact ? U"{}" : U"{ }";
+                    break;
+                }
+                const char32_t *prefix = state.multiline ? U"{\n" : U"{";
+                const char32_t *separator = state.multiline ? U",\n"
+                                          : state.compact ? U"," : U", ";
+                size_t cindent_length = state.cindent.length();
+                if (state.multiline) state.cindent += state.indent;
+                for (const auto &f : fields) {
+                    // pushes FRAME_CALL
+                    const AST *body = objectIndex(loc, obj, f.second, 0);
+                    stack.top().val = scratch;
+                    evaluate(body, stack.size());
+                    out += prefix;
+                    if (state.multiline) out += state.cindent;
+                    if (state.style == MANIFEST_PYTHON) {
+                        escape_string_json(f.first, out);
+                    } else {
+                        out += U"\"";
+                        out += f.first;
+                        out += U"\"";
                     }
-                    ss << (multiline ? U"\n" : U"") << indent << U"}";
+                    out += state.compact ? U":" : U": ";
+                    if (state.style == MANIFEST_JSON_EX) state.path.push_back({f.second, 0});
+                    manifestJson(body->location, state);
+                    if (state.style == MANIFEST_JSON_EX) state.path.pop_back();
+                    // Reset scratch so that the object we're manifesting doesn't
+                    // get GC'd.
+                    scratch = stack.top().val;
+                    stack.pop();
+                    prefix = separator;
+                    manifestFlush(state, false);
+                }
+                if (fields.size() == 0) out += prefix;
+                state.cindent.resize(cindent_length);
+                if (state.multiline) {
+                    out += U"\n";
+                    out += state.cindent;
                 }
+                out += U"}";
             }
             break;
 
             case Value::STRING: {
-                const String &str = static_cast<HeapString*>(scratch.v.h)->value;
-                ss << jsonlang_string_unparse(str, false);
+                const auto *heap_str = static_cast<HeapString*>(scratch.v.h);
+                if (heap_str->utf8 != nullptr && state.style == MANIFEST_JSON
+                    && state.sink != nullptr) {
+                    // Escape the bytes of the file straight into the output.
+                    manifestFlush(state, true);
+                    state.utf8.assign(1, '"');
+                    jsonlang_string_escape_utf8(heap_str->utf8->data(), heap_str->utf8Length,
+                                                state.utf8);
+                    state.utf8 += '"';
+                    state.sink->write(state.utf8.data(), state.utf8.length());
+                    break;
+                }
+                const String &str = heap_str->value();
+                if (state.style == MANIFEST_JSON) {
+                    out += U'"';
+                    jsonlang_string_escape(str, false, false, out);
+                    out += U'"';
+                } else {
+                    escape_string_json(str, out);
+                }
             }
             break;
         }
-        return ss.str();
     }
 
-    String manifestString(const LocationRange &loc)
+    /** The path to the value being manifested by std.manifestJsonEx, as Jsonlang would write
+     * the array of its field names and indexes.
+     */
+    std::string manifestPath(const ManifestState &state)
+    {
+        if (state.path.size() == 0) return "[ ]";
+        String r = U"[";
+        const char32_t *prefix = U"";
+        for (const auto &el : state.path) {
+            r += prefix;
+            if (el.field != nullptr) {
+                r += jsonlang_string_unparse(el.field->name, false);
+            } else {
+                r += decode_utf8(jsonlang_unparse_number(el.index));
+            }
+            prefix = U", ";
+        }
+        r += U"]";
+        return encode_utf8(r);
+    }
+
+    /** Write the scratch value, which must be a string, to output in UTF-8 as it is. */
+    void manifestString(const LocationRange &loc, VmOutput &output)
     {
         if (scratch.t != Value::STRING) {
             std::stringstream ss;
             ss << "Expected string result, got: " << type_str(scratch.t);
             throw makeError(loc, ss.str());
         }
-        return static_cast<HeapString*>(scratch.v.h)->value;
+        const auto *str = static_cast<HeapString*>(scratch.v.h);
+        if (str->utf8 != nullptr) {
+            output.write(str->utf8->data(), str->utf8Length);
+            return;
+        }
+        std::string utf8 = encode_utf8(str->value());
+        output.write(utf8.data(), utf8.length());
+    }
+
+    /** Manifest the field f of obj as a file of multi mode. */
+    void manifestMultiFile(const LocationRange &loc, HeapObject *obj,
+                           const std::pair<const String, const Identifier*> &f, bool string,
+                           VmOutputFormat format, VmOutput &output)
+    {
+        // pushes FRAME_CALL
+        const AST *body = objectIndex(loc, obj, f.second, 0);
+        stack.top().val = scratch;
+        evaluate(body, stack.size());
+        output.beginDocument(encode_utf8(f.first).c_str());
+        if (string) {
+            manifestString(body->location, output);
+        } else {
+            manifestJson(body->location, format, output);
+        }
+        output.endDocument();
+        // Reset scratch so that the object we're manifesting doesn't
+        // get GC'd.
+        scratch = stack.top().val;
+        stack.pop();
     }
 
-    StrMap manifestMulti(bool string)
+    /** Manifest the scratch value, which must be an object, as a file for each field.
+     *
+     * \param string Whether each field is a string to output without JSON encoding.
+     * \param jobs If more than 1, the number of processes to manifest the files in.
+     */
+    void manifestMulti(bool string, VmOutputFormat format, unsigned jobs, VmOutput &output)
     {
-        StrMap r;
         LocationRange loc("During manifestation");
         if (scratch.t != Value::OBJECT) {
             std::stringstream ss;
@@ -2839,29 +6020,226 @@ class Interpreter {
         }
         auto *obj = static_cast<HeapObject*>(scratch.v.h);
         runInvariants(loc, obj);
-        std::map<String, const Identifier*> fields;
-        for (const auto &f : objectFields(obj, true)) {
-            fields[f->name] = f;
+        auto fields = sortedFields(obj);
+        if (jobs > 1 && fields.size() > 1) {
+            manifestMultiForked(loc, obj, fields, string, format, jobs, output);
+            return;
         }
         for (const auto &f : fields) {
-            // pushes FRAME_CALL
-            const AST *body = objectIndex(loc, obj, f.second, 0);
-            stack.top().val = scratch;
-            evaluate(body, stack.size());
-            auto vstr = string ? manifestString(body->location)
-                               : manifestJson(body->location, true, U"");
-            // Reset scratch so that the object we're manifesting doesn't
-            // get GC'd.
-            scratch = stack.top().val;
-            stack.pop();
-            r[encode_utf8(f.first)] = encode_utf8(vstr);
+            manifestMultiFile(loc, obj, f, string, format, output);
         }
-        return r;
     }
 
-    std::vector<std::string> manifestStream(void)
+    /** The work of one of the processes of manifestMultiForked: manifest every jobs'th file,
+     * starting with the job'th, and send each to the parent through fd.
+     *
+     * Each record is its length, a WorkerRecordKind, then either the file or, for an error,
+     * whether the file was begun, the output so far, and the error.  There are no more records
+     * after an error.
+     */
+    void manifestMultiWorker(const LocationRange &loc, HeapObject *obj,
+                             const std::vector<const std::pair<const String,
+                                                               const Identifier*>*> &fields,
+                             bool string, VmOutputFormat format, unsigned job, unsigned jobs,
+                             int fd)
+    {
+        for (size_t i = job ; i < fields.size() ; i += jobs) {
+            WorkerDocument doc;
+            std::string record;
+            bool failed = true;
+            auto put_failure = [&](WorkerRecordKind kind) {
+                record_put(record, uint64_t(kind));
+                record_put(record, uint64_t(doc.begun));
+                record_put(record, doc.content);
+            };
+            try {
+                manifestMultiFile(loc, obj, *fields[i], string, format, doc);
+                failed = false;
+                record_put(record, uint64_t(RECORD_FILE));
+                record_put(record, doc.content);
+            } catch (const RuntimeError &e) {
+                put_failure(RECORD_RUNTIME_ERROR);
+                record_put(record, e.msg);
+                record_put(record, uint64_t(e.stackTrace.size()));
+                for (const auto &frame : e.stackTrace) {
+                    record_put(record, frame.location.file);
+                    record_put(record, frame.location.begin.line);
+                    record_put(record, frame.location.begin.column);
+                    record_put(record, frame.location.end.line);
+                    record_put(record, frame.location.end.column);
+                    record_put(record, frame.name);
+                }
+            } catch (const StaticError &e) {
+                // E.g. from a file that the field imports.
+                put_failure(RECORD_STATIC_ERROR);
+                record_put(record, e.location.file);
+                record_put(record, e.location.begin.line);
+                record_put(record, e.location.begin.column);
+                record_put(record, e.location.end.line);
+                record_put(record, e.location.end.column);
+                record_put(record, e.msg);
+            } catch (const std::bad_alloc &) {
+                put_failure(RECORD_OUT_OF_MEMORY);
+            } catch (const std::exception &e) {
+                put_failure(RECORD_EXCEPTION);
+                record_put(record, std::string(e.what()));
+            }
+            std::string len;
+            record_put(len, uint64_t(record.length()));
+            if (!write_all(fd, len) || !write_all(fd, record)) return;
+            if (failed) return;
+        }
+    }
+
+    /** Manifest the files of multi mode in jobs forked processes, which share the heap as it
+     * is now, copy on write.  The files are passed on to output in the same order, and with
+     * the same errors, as the serial version.
+     */
+    void manifestMultiForked(const LocationRange &loc, HeapObject *obj,
+                             const std::map<String, const Identifier*> &sorted, bool string,
+                             VmOutputFormat format, unsigned jobs, VmOutput &output)
+    {
+        std::vector<const std::pair<const String, const Identifier*>*> fields;
+        for (const auto &f : sorted) fields.push_back(&f);
+        jobs = std::min<size_t>(jobs, fields.size());
+
+        WorkerProcesses workers;
+        for (unsigned job = 0 ; job < jobs ; ++job) {
+            int fds[2];
+            if (pipe(fds) != 0) {
+                throw makeError(loc, std::string("Multi mode: could not create pipe: ")
+                                     + strerror(errno));
+            }
+            pid_t pid = fork();
+            if (pid < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                throw makeError(loc, std::string("Multi mode: could not fork: ")
+                                     + strerror(errno));
+            }
+            if (pid == 0) {
+                // Nothing may escape from here into the caller, which belongs to the parent.
+                close(fds[0]);
+                for (int fd : workers.fds) close(fd);
+                workers.fds.clear();
+                workers.pids.clear();
+                int status = 0;
+                try {
+                    manifestMultiWorker(loc, obj, fields, string, format, job, jobs, fds[1]);
+                } catch (...) {
+                    status = 1;
+                }
+                _exit(status);
+            }
+            close(fds[1]);
+            workers.pids.push_back(pid);
+            workers.fds.push_back(fds[0]);
+        }
+
+        // Read from all the workers at once, so none is held up by a full pipe, and pass each
+        // file on as soon as those before it have been.
+        std::vector<std::string> bufs(jobs);
+        std::vector<std::deque<std::string>> records(jobs);
+        std::vector<char> buf(1 << 16);
+        size_t next = 0;
+        while (next < fields.size()) {
+            unsigned job = next % jobs;
+            if (!records[job].empty()) {
+                std::string record = std::move(records[job].front());
+                records[job].pop_front();
+                RecordReader reader(record);
+                const std::string name = encode_utf8(fields[next]->first);
+                const auto kind = WorkerRecordKind(reader.u64());
+                if (kind == RECORD_FILE) {
+                    std::string content = reader.str();
+                    output.beginDocument(name.c_str());
+                    output.write(content.data(), content.length());
+                    output.endDocument();
+                    next++;
+                    continue;
+                }
+                bool begun = reader.u64() != 0;
+                std::string content = reader.str();
+                if (begun) {
+                    output.beginDocument(name.c_str());
+                    output.write(content.data(), content.length());
+                }
+                switch (kind) {
+                    case RECORD_RUNTIME_ERROR: {
+                        std::string msg = reader.str();
+                        std::vector<TraceFrame> stack_trace;
+                        for (uint64_t i = reader.u64() ; i > 0 ; --i) {
+                            LocationRange frame_loc;
+                            frame_loc.file = reader.str();
+                            frame_loc.begin.line = reader.u64();
+                            frame_loc.begin.column = reader.u64();
+                            frame_loc.end.line = reader.u64();
+                            frame_loc.end.column = reader.u64();
+                            std::string frame_name = reader.str();
+                            stack_trace.emplace_back(frame_loc, frame_name);
+                        }
+                        throw RuntimeError(stack_trace, msg);
+                    }
+                    case RECORD_STATIC_ERROR: {
+                        LocationRange error_loc;
+                        error_loc.file = reader.str();
+                        error_loc.begin.line = reader.u64();
+                        error_loc.begin.column = reader.u64();
+                        error_loc.end.line = reader.u64();
+                        error_loc.end.column = reader.u64();
+                        throw StaticError(error_loc, reader.str());
+                    }
+                    case RECORD_OUT_OF_MEMORY:
+                        throw std::bad_alloc();
+                    default:
+                        throw std::runtime_error(reader.str());
+                }
+            }
+            if (workers.fds[job] < 0)
+                throw makeError(loc, "Multi mode: a worker process failed.");
+
+            std::vector<pollfd> pfds;
+            for (int fd : workers.fds) {
+                if (fd >= 0) pfds.push_back(pollfd{fd, POLLIN, 0});
+            }
+            if (poll(pfds.data(), pfds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                throw makeError(loc, std::string("Multi mode: poll: ") + strerror(errno));
+            }
+            for (const auto &pfd : pfds) {
+                if (pfd.revents == 0) continue;
+                unsigned j = std::find(workers.fds.begin(), workers.fds.end(), pfd.fd)
+                           - workers.fds.begin();
+                ssize_t r = read(pfd.fd, buf.data(), buf.size());
+                if (r < 0 && errno == EINTR) continue;
+                if (r <= 0) {
+                    close(pfd.fd);
+                    workers.fds[j] = -1;
+                    continue;
+                }
+                std::string &b = bufs[j];
+                b.append(buf.data(), r);
+                size_t pos = 0;
+                while (b.length() - pos >= sizeof(uint64_t)) {
+                    uint64_t len;
+                    memcpy(&len, b.data() + pos, sizeof len);
+                    if (b.length() - pos - sizeof len < len) break;
+                    records[j].push_back(b.substr(pos + sizeof len, len));
+                    pos += sizeof len + len;
+                }
+                b.erase(0, pos);
+            }
+        }
+        workers.closeAll();
+        workers.waitAll();
+    }
+
+    /** Manifest the scratch value, which must be an array, as a document for each element.
+     *
+     * Each document is written to output as soon as it is manifested.
+     */
+    void manifestStream(VmOutputFormat format, VmOutput &output)
     {
-        std::vector<std::string> r;
         LocationRange loc("During manifestation");
         if (scratch.t != Value::ARRAY) {
             std::stringstream ss;
@@ -2876,7 +6254,7 @@ class Interpreter {
                                ? loc
                                : thunk->body->location;
             if (thunk->filled) {
-                stack.newCall(loc, thunk, nullptr, 0, BindingFrame{});
+                stack.newCall(loc, thunk, nullptr, 0, nullptr);
                 // Keep arr alive when scratch is overwritten
                 stack.top().val = scratch;
                 scratch = thunk->content;
@@ -2886,19 +6264,32 @@ class Interpreter {
                 stack.top().val = scratch;
                 evaluate(thunk->body, stack.size());
             }
-            String element = manifestJson(tloc, true, U"");
+            output.beginDocument(nullptr);
+            manifestJson(tloc, format, output);
+            output.endDocument();
             scratch = stack.top().val;
             stack.pop();
-            r.push_back(encode_utf8(element));
         }
-        return r;
     }
 
 };
 
+/** Collects the files of multi mode, or the documents of stream mode, in memory. */
+struct DocumentsOutput : public VmOutput {
+    std::vector<std::pair<std::string, std::string>> documents;
+    void beginDocument(const char *name)
+    {
+        documents.emplace_back(name == nullptr ? "" : name, "");
+    }
+    void write(const char *data, size_t len)
+    {
+        documents.back().second.append(data, len);
+    }
+};
+
 }  // namespace
 
-std::string jsonlang_vm_execute(
+void jsonlang_vm_execute(
     Allocator *alloc,
     const AST *ast,
     const ExtMap &ext_vars,
@@ -2908,19 +6299,43 @@ std::string jsonlang_vm_execute(
     const VmNativeCallbackMap &natives,
     JsonlangImportCallback *import_callback,
     void *ctx,
-    bool string_output)
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format,
+    VmOutput &output)
 {
     Interpreter vm(alloc, ext_vars, max_stack, gc_min_objects, gc_growth_trigger,
-                   natives, import_callback, ctx);
+                   natives, import_callback, ctx, import_loader);
     vm.evaluate(ast, 0);
     if (string_output) {
-        return encode_utf8(vm.manifestString(LocationRange("During manifestation")));
+        vm.manifestString(LocationRange("During manifestation"), output);
     } else {
-        return encode_utf8(vm.manifestJson(LocationRange("During manifestation"), true, U""));
+        vm.manifestJson(LocationRange("During manifestation"), format, output);
     }
 }
 
-StrMap jsonlang_vm_execute_multi(
+std::string jsonlang_vm_execute(
+    Allocator *alloc,
+    const AST *ast,
+    const ExtMap &ext_vars,
+    unsigned max_stack,
+    double gc_min_objects,
+    double gc_growth_trigger,
+    const VmNativeCallbackMap &natives,
+    JsonlangImportCallback *import_callback,
+    void *ctx,
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format)
+{
+    VmStringOutput output;
+    jsonlang_vm_execute(alloc, ast, ext_vars, max_stack, gc_min_objects, gc_growth_trigger,
+                        natives, import_callback, ctx, import_loader, string_output, format,
+                        output);
+    return output.str;
+}
+
+void jsonlang_vm_execute_multi(
     Allocator *alloc,
     const AST *ast,
     const ExtMap &ext_vars,
@@ -2930,15 +6345,41 @@ StrMap jsonlang_vm_execute_multi(
     const VmNativeCallbackMap &natives,
     JsonlangImportCallback *import_callback,
     void *ctx,
-    bool string_output)
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format,
+    unsigned jobs,
+    VmOutput &output)
 {
     Interpreter vm(alloc, ext_vars, max_stack, gc_min_objects, gc_growth_trigger,
-                   natives, import_callback, ctx);
+                   natives, import_callback, ctx, import_loader);
     vm.evaluate(ast, 0);
-    return vm.manifestMulti(string_output);
+    vm.manifestMulti(string_output, format, jobs, output);
 }
 
-std::vector<std::string> jsonlang_vm_execute_stream(
+StrMap jsonlang_vm_execute_multi(
+    Allocator *alloc,
+    const AST *ast,
+    const ExtMap &ext_vars,
+    unsigned max_stack,
+    double gc_min_objects,
+    double gc_growth_trigger,
+    const VmNativeCallbackMap &natives,
+    JsonlangImportCallback *import_callback,
+    void *ctx,
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format,
+    unsigned jobs)
+{
+    DocumentsOutput output;
+    jsonlang_vm_execute_multi(alloc, ast, ext_vars, max_stack, gc_min_objects,
+                              gc_growth_trigger, natives, import_callback, ctx, import_loader,
+                              string_output, format, jobs, output);
+    return StrMap(output.documents.begin(), output.documents.end());
+}
+
+void jsonlang_vm_execute_stream(
     Allocator *alloc,
     const AST *ast,
     const ExtMap &ext_vars,
@@ -2947,10 +6388,35 @@ std::vector<std::string> jsonlang_vm_execute_stream(
     double gc_growth_trigger,
     const VmNativeCallbackMap &natives,
     JsonlangImportCallback *import_callback,
-    void *ctx)
+    void *ctx,
+    VmImportLoader *import_loader,
+    VmOutputFormat format,
+    VmOutput &output)
 {
     Interpreter vm(alloc, ext_vars, max_stack, gc_min_objects, gc_growth_trigger,
-                   natives, import_callback, ctx);
+                   natives, import_callback, ctx, import_loader);
     vm.evaluate(ast, 0);
-    return vm.manifestStream();
+    vm.manifestStream(format, output);
+}
+
+std::vector<std::string> jsonlang_vm_execute_stream(
+    Allocator *alloc,
+    const AST *ast,
+    const ExtMap &ext_vars,
+    unsigned max_stack,
+    double gc_min_objects,
+    double gc_growth_trigger,
+    const VmNativeCallbackMap &natives,
+    JsonlangImportCallback *import_callback,
+    void *ctx,
+    VmImportLoader *import_loader,
+    VmOutputFormat format)
+{
+    DocumentsOutput output;
+    jsonlang_vm_execute_stream(alloc, ast, ext_vars, max_stack, gc_min_objects,
+                               gc_growth_trigger, natives, import_callback, ctx, import_loader,
+                               format, output);
+    std::vector<std::string> r;
+    for (auto &doc : output.documents) r.push_back(std::move(doc.second));
+    return r;
 }
@@ -33,9 +33,12 @@ limitations under the License.
 #ifndef JSONLANG_VM_H
 #define JSONLANG_VM_H
 
+#include <memory>
+
 #include <libjsonlang.h>
 
 #include "ast.h"
+#include "file_source.h"
 
 /** A single line of a stack trace from a runtime error.
  */
@@ -77,6 +80,85 @@ struct VmExt {
     { }
 };
 
+/** Loads an import, like JsonlangImportCallback, but shares the content instead of copying it.
+ *
+ * \param ctx The import callback context.
+ * \param found_here Set to the path of the file, when it is found.
+ * \param err_msg Set to the reason the import failed, when nullptr is returned.
+ */
+typedef std::shared_ptr<const FileSource> VmImportLoader(void *ctx, const std::string &dir,
+                                                         const std::string &rel,
+                                                         std::string &found_here,
+                                                         std::string &err_msg);
+
+/** How jsonlang_vm_execute and friends write the output value. */
+enum VmOutputFormat {
+    /** Objects and arrays spread over lines, indented by three spaces per level. */
+    VM_OUTPUT_JSON,
+    /** Minified, with no whitespace at all between tokens. */
+    VM_OUTPUT_JSON_COMPACT,
+    /** Binary, as CBOR (RFC 7049). */
+    VM_OUTPUT_CBOR,
+    /** Binary, as MessagePack. */
+    VM_OUTPUT_MSGPACK
+};
+
+/** Receives the output of jsonlang_vm_execute in UTF-8, a chunk at a time, as it is manifested.
+ *
+ * The whole output is therefore never held in memory by the interpreter.  If there is an error
+ * part way through, some of the output will already have been written.
+ */
+struct VmOutput {
+    virtual ~VmOutput() { }
+    /** Called with each successive chunk of the output. */
+    virtual void write(const char *data, size_t len) = 0;
+    /** Multi and stream mode: called before the output of each file or document.
+     *
+     * \param name The filename in multi mode, nullptr in stream mode.
+     */
+    virtual void beginDocument(const char *name) { (void) name; }
+    /** Multi and stream mode: called after the output of each file or document. */
+    virtual void endDocument(void) { }
+};
+
+/** Collects the output in a string. */
+struct VmStringOutput : public VmOutput {
+    std::string str;
+    void write(const char *data, size_t len)
+    {
+        str.append(data, len);
+    }
+};
+
+/** Execute the program and write the value, as JSON, to output.
+ *
+ * \param alloc The allocator used to create the ast.
+ * \param ast The program to execute.
+ * \param ext The external vars / code.
+ * \param max_stack Recursion beyond this level gives an error.
+ * \param gc_min_objects The garbage collector does not run when the heap is this small.
+ * \param gc_growth_trigger Growth since last garbage collection cycle to trigger a new cycle.
+ * \param import_callback A callback to handle imports
+ * \param import_callback_ctx Context param for the import callback.
+ * \param import_loader If not null, loads imports instead of import_callback.
+ * \param output_string Whether to expect a string and output it without JSON encoding
+ * \param format How to write the value.
+ * \param output Receives the JSON as it is manifested.
+ * \throws RuntimeError reports runtime errors in the program.
+ */
+void jsonlang_vm_execute(
+    Allocator *alloc, const AST *ast,
+    const std::map<std::string, VmExt> &ext,
+    unsigned max_stack,
+    double gc_min_objects,
+    double gc_growth_trigger,
+    const VmNativeCallbackMap &natives,
+    JsonlangImportCallback *import_callback,
+    void *import_callback_ctx,
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format,
+    VmOutput &output);
 
 /** Execute the program and return the value as a JSON string.
  *
@@ -88,7 +170,9 @@ struct VmExt {
  * \param gc_growth_trigger Growth since last garbage collection cycle to trigger a new cycle.
  * \param import_callback A callback to handle imports
  * \param import_callback_ctx Context param for the import callback.
+ * \param import_loader If not null, loads imports instead of import_callback.
  * \param output_string Whether to expect a string and output it without JSON encoding
+ * \param format How to write the value.
  * \throws RuntimeError reports runtime errors in the program.
  * \returns The JSON result in string form.
  */
@@ -101,7 +185,34 @@ std::string jsonlang_vm_execute(
     const VmNativeCallbackMap &natives,
     JsonlangImportCallback *import_callback,
     void *import_callback_ctx,
-    bool string_output);
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format);
+
+/** Execute the program and write the value, as a number of named JSON files, to output.
+ *
+ * Each file is written between calls to output.beginDocument and output.endDocument.  The
+ * other parameters are as for jsonlang_vm_execute.
+ *
+ * \param jobs If more than 1, the files are manifested by this many forked processes, which
+ * share the evaluated top-level object.  The output is the same, in the same order.
+ * \throws RuntimeError reports runtime errors in the program.
+ */
+void jsonlang_vm_execute_multi(
+    Allocator *alloc,
+    const AST *ast,
+    const std::map<std::string, VmExt> &ext,
+    unsigned max_stack,
+    double gc_min_objects,
+    double gc_growth_trigger,
+    const VmNativeCallbackMap &natives,
+    JsonlangImportCallback *import_callback,
+    void *import_callback_ctx,
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format,
+    unsigned jobs,
+    VmOutput &output);
 
 /** Execute the program and return the value as a number of named JSON files.
  *
@@ -116,7 +227,10 @@ std::string jsonlang_vm_execute(
  * \param gc_growth_trigger Growth since last garbage collection cycle to trigger a new cycle.
  * \param import_callback A callback to handle imports
  * \param import_callback_ctx Context param for the import callback.
+ * \param import_loader If not null, loads imports instead of import_callback.
  * \param output_string Whether to expect a string and output it without JSON encoding
+ * \param format How to write the value.
+ * \param jobs The number of processes to manifest the files in.
  * \throws RuntimeError reports runtime errors in the program.
  * \returns A mapping from filename to the JSON strings for that file.
  */
@@ -130,7 +244,31 @@ std::map<std::string, std::string> jsonlang_vm_execute_multi(
     const VmNativeCallbackMap &natives,
     JsonlangImportCallback *import_callback,
     void *import_callback_ctx,
-    bool string_output);
+    VmImportLoader *import_loader,
+    bool string_output,
+    VmOutputFormat format,
+    unsigned jobs);
+
+/** Execute the program and write the value, as a stream of JSON files, to output.
+ *
+ * Each document is written between calls to output.beginDocument and output.endDocument, as
+ * soon as it has been manifested.  The parameters are as for jsonlang_vm_execute.
+ *
+ * \throws RuntimeError reports runtime errors in the program.
+ */
+void jsonlang_vm_execute_stream(
+    Allocator *alloc,
+    const AST *ast,
+    const std::map<std::string, VmExt> &ext,
+    unsigned max_stack,
+    double gc_min_objects,
+    double gc_growth_trigger,
+    const VmNativeCallbackMap &natives,
+    JsonlangImportCallback *import_callback,
+    void *import_callback_ctx,
+    VmImportLoader *import_loader,
+    VmOutputFormat format,
+    VmOutput &output);
 
 /** Execute the program and return the value as a stream of JSON files.
  *
@@ -146,7 +284,8 @@ std::map<std::string, std::string> jsonlang_vm_execute_multi(
  * \param gc_growth_trigger Growth since last garbage collection cycle to trigger a new cycle.
  * \param import_callback A callback to handle imports
  * \param import_callback_ctx Context param for the import callback.
- * \param output_string Whether to expect a string and output it without JSON encoding
+ * \param import_loader If not null, loads imports instead of import_callback.
+ * \param format How to write the value.
  * \throws RuntimeError reports runtime errors in the program.
  * \returns A mapping from filename to the JSON strings for that file.
  */
@@ -159,6 +298,8 @@ std::vector<std::string> jsonlang_vm_execute_stream(
     double gc_growth_trigger,
     const VmNativeCallbackMap &natives,
     JsonlangImportCallback *import_callback,
-    void *import_callback_ctx);
+    void *import_callback_ctx,
+    VmImportLoader *import_loader,
+    VmOutputFormat format);
 
 #endif
@@ -68,6 +68,30 @@ void jsonlang_gc_growth_trigger(struct JsonlangVm *vm, double v);
 /** Expect a string as output and don't JSON encode it. */
 void jsonlang_string_output(struct JsonlangVm *vm, int v);
 
+/** Write the JSON output minified, without any whitespace, rather than indented. */
+void jsonlang_output_compact(struct JsonlangVm *vm, int v);
+
+/** Set the format of the output: "json" (the default), "cbor" or "msgpack".
+ *
+ * CBOR and MessagePack are binary, so can only be had from the jsonlang_evaluate_*_write
+ * functions, and each file or document is not followed by a newline.  Numbers that are integers
+ * are written as such.
+ *
+ * String output (jsonlang_string_output) overrides the format: the strings are written as plain
+ * text whatever the format is set to.
+ *
+ * \returns 0 if the format is unknown, in which case it is not changed, otherwise 1.
+ */
+int jsonlang_output_format(struct JsonlangVm *vm, const char *format);
+
+/** Manifest the files of multi mode in this many processes.
+ *
+ * After the top-level object is evaluated, the process forks workers that share its heap.  The
+ * output is the same as with one process, which is the default.  Not for use from a process
+ * that has other threads running.
+ */
+void jsonlang_jobs(struct JsonlangVm *vm, unsigned v);
+
 /** Callback used to load imports.
  *
  * The returned char* should be allocated with jsonlang_realloc.  It will be cleaned up by
@@ -375,6 +399,127 @@ char *jsonlang_evaluate_snippet_stream(struct JsonlangVm *vm,
                                       const char *snippet,
                                       int *error);
 
+/** Callback used to receive the output of the jsonlang_evaluate_*_write family of functions.
+ *
+ * It is called with each successive chunk of the UTF-8 output, as soon as it is manifested.
+ *
+ * \param ctx User pointer, given to the jsonlang_evaluate_*_write function.
+ * \param buf The chunk of output, which is not \0 terminated.
+ * \param len The number of bytes in buf.
+ * \returns 0 to continue, or anything else to stop the evaluation with an error.
+ */
+typedef int JsonlangWriteCallback(void *ctx, const char *buf, size_t len);
+
+/** Callback used to mark the start and end of each file in multi mode, or each document in
+ * stream mode.
+ *
+ * \param ctx User pointer, given to the jsonlang_evaluate_*_write function.
+ * \param name The filename in multi mode, NULL in stream mode.
+ * \returns 0 to continue, or anything else to stop the evaluation with an error.
+ */
+typedef int JsonlangDocumentCallback(void *ctx, const char *name);
+
+/** Evaluate a file containing Jsonlang code, writing the JSON to a callback as it is produced.
+ *
+ * The output is the same as that of jsonlang_evaluate_file, but is never held in memory all at
+ * once.  If there is an error, some output may already have been written.
+ *
+ * \param filename Path to a file containing Jsonlang code.
+ * \param write Receives the JSON.
+ * \param ctx User pointer, given to write.
+ * \param error Return by reference whether or not there was an error.
+ * \returns NULL, or the error message, which should be cleaned up with jsonlang_realloc.
+ */
+char *jsonlang_evaluate_file_write(struct JsonlangVm *vm,
+                                  const char *filename,
+                                  JsonlangWriteCallback *write,
+                                  void *ctx,
+                                  int *error);
+
+/** Evaluate a string containing Jsonlang code, writing the JSON to a callback as it is produced.
+ *
+ * \see jsonlang_evaluate_file_write
+ *
+ * \param filename Path to a file (used in error messages).
+ * \param snippet Jsonlang code to execute.
+ */
+char *jsonlang_evaluate_snippet_write(struct JsonlangVm *vm,
+                                     const char *filename,
+                                     const char *snippet,
+                                     JsonlangWriteCallback *write,
+                                     void *ctx,
+                                     int *error);
+
+/** Evaluate a file containing Jsonlang code, writing a number of named JSON files to callbacks.
+ *
+ * The JSON of each file, followed by a newline, is given to write between calls of begin and end
+ * with its filename.  begin and end may be NULL.  If there is an error, some files may already
+ * have been written.
+ *
+ * \param filename Path to a file containing Jsonlang code.
+ * \param ctx User pointer, given to the callbacks.
+ * \param error Return by reference whether or not there was an error.
+ * \returns NULL, or the error message, which should be cleaned up with jsonlang_realloc.
+ */
+char *jsonlang_evaluate_file_multi_write(struct JsonlangVm *vm,
+                                        const char *filename,
+                                        JsonlangDocumentCallback *begin,
+                                        JsonlangWriteCallback *write,
+                                        JsonlangDocumentCallback *end,
+                                        void *ctx,
+                                        int *error);
+
+/** Evaluate a string containing Jsonlang code, writing a number of named JSON files to callbacks.
+ *
+ * \see jsonlang_evaluate_file_multi_write
+ *
+ * \param filename Path to a file (used in error messages).
+ * \param snippet Jsonlang code to execute.
+ */
+char *jsonlang_evaluate_snippet_multi_write(struct JsonlangVm *vm,
+                                           const char *filename,
+                                           const char *snippet,
+                                           JsonlangDocumentCallback *begin,
+                                           JsonlangWriteCallback *write,
+                                           JsonlangDocumentCallback *end,
+                                           void *ctx,
+                                           int *error);
+
+/** Evaluate a file containing Jsonlang code, writing a number of JSON files to callbacks.
+ *
+ * Each document is written, followed by a newline, as soon as it has been manifested.  It is
+ * given to write between calls of begin and end with a NULL name.  begin and end may be NULL.
+ * If there is an error, some documents may already have been written.
+ *
+ * \param filename Path to a file containing Jsonlang code.
+ * \param ctx User pointer, given to the callbacks.
+ * \param error Return by reference whether or not there was an error.
+ * \returns NULL, or the error message, which should be cleaned up with jsonlang_realloc.
+ */
+char *jsonlang_evaluate_file_stream_write(struct JsonlangVm *vm,
+                                         const char *filename,
+                                         JsonlangDocumentCallback *begin,
+                                         JsonlangWriteCallback *write,
+                                         JsonlangDocumentCallback *end,
+                                         void *ctx,
+                                         int *error);
+
+/** Evaluate a string containing Jsonlang code, writing a number of JSON files to callbacks.
+ *
+ * \see jsonlang_evaluate_file_stream_write
+ *
+ * \param filename Path to a file (used in error messages).
+ * \param snippet Jsonlang code to execute.
+ */
+char *jsonlang_evaluate_snippet_stream_write(struct JsonlangVm *vm,
+                                            const char *filename,
+                                            const char *snippet,
+                                            JsonlangDocumentCallback *begin,
+                                            JsonlangWriteCallback *write,
+                                            JsonlangDocumentCallback *end,
+                                            void *ctx,
+                                            int *error);
+
 /** Complement of \see jsonlang_vm_make. */
 void jsonlang_destroy(struct JsonlangVm *vm);
 
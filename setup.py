@@ -35,6 +35,7 @@ from subprocess import Popen
 DIR = os.path.abspath(os.path.dirname(__file__))
 LIB_OBJECTS = [
     'core/desugarer.o',
+    'core/file_source.o',
     'core/formatter.o',
     'core/libjsonlang.o',
     'core/lexer.o',
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+
+# Copyright 2016 LambdaStack All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Reads output of the given format (json, cbor or msgpack) on stdin and writes it as
+# canonical JSON, so that the formats can be compared.  Only the subset of CBOR and
+# MessagePack written by jsonlang --output-format is understood.
+
+import json
+import struct
+import sys
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise ValueError('truncated input')
+        r = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return r
+
+    def uint(self, n):
+        return int.from_bytes(self.take(n), 'big')
+
+    def sint(self, n):
+        return int.from_bytes(self.take(n), 'big', signed=True)
+
+
+def cbor(r):
+    head = r.uint(1)
+    major, info = head >> 5, head & 0x1f
+    if major == 7:
+        simple = {20: False, 21: True, 22: None}
+        if info in simple:
+            return simple[info]
+        if info == 27:
+            return struct.unpack('>d', r.take(8))[0]
+        raise ValueError('unexpected CBOR simple value %d' % info)
+    if info < 24:
+        arg = info
+    elif info <= 27:
+        arg = r.uint(1 << (info - 24))
+    else:
+        raise ValueError('unexpected CBOR argument %d' % info)
+    if major == 0:
+        return arg
+    if major == 1:
+        return -1 - arg
+    if major == 3:
+        return r.take(arg).decode('utf-8')
+    if major == 4:
+        return [cbor(r) for _ in range(arg)]
+    if major == 5:
+        return dict((cbor(r), cbor(r)) for _ in range(arg))
+    raise ValueError('unexpected CBOR major type %d' % major)
+
+
+def msgpack(r):
+    tag = r.uint(1)
+    if tag < 0x80:
+        return tag
+    if tag >= 0xe0:
+        return tag - 0x100
+    if 0x80 <= tag <= 0x8f:
+        return dict((msgpack(r), msgpack(r)) for _ in range(tag & 0xf))
+    if 0x90 <= tag <= 0x9f:
+        return [msgpack(r) for _ in range(tag & 0xf)]
+    if 0xa0 <= tag <= 0xbf:
+        return r.take(tag & 0x1f).decode('utf-8')
+    simple = {0xc0: None, 0xc2: False, 0xc3: True}
+    if tag in simple:
+        return simple[tag]
+    if tag == 0xcb:
+        return struct.unpack('>d', r.take(8))[0]
+    if 0xcc <= tag <= 0xcf:
+        return r.uint(1 << (tag - 0xcc))
+    if 0xd0 <= tag <= 0xd3:
+        return r.sint(1 << (tag - 0xd0))
+    if 0xd9 <= tag <= 0xdb:
+        return r.take(r.uint(1 << (tag - 0xd9))).decode('utf-8')
+    if tag in (0xdc, 0xdd):
+        return [msgpack(r) for _ in range(r.uint(2 if tag == 0xdc else 4))]
+    if tag in (0xde, 0xdf):
+        n = r.uint(2 if tag == 0xde else 4)
+        return dict((msgpack(r), msgpack(r)) for _ in range(n))
+    raise ValueError('unexpected MessagePack tag 0x%x' % tag)
+
+
+def canonical(v):
+    """Integral floats become ints, as JSON does not distinguish them."""
+    if isinstance(v, float) and v == int(v):
+        return int(v)
+    if isinstance(v, list):
+        return [canonical(x) for x in v]
+    if isinstance(v, dict):
+        return dict((k, canonical(x)) for k, x in v.items())
+    return v
+
+
+def main():
+    data = sys.stdin.buffer.read()
+    if sys.argv[1] == 'json':
+        value = json.loads(data.decode('utf-8'))
+    else:
+        r = Reader(data)
+        value = cbor(r) if sys.argv[1] == 'cbor' else msgpack(r)
+        if r.pos != len(data):
+            raise ValueError('trailing bytes')
+    print(json.dumps(canonical(value), sort_keys=True))
+
+
+main()
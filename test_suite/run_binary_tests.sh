@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Copyright 2016 LambdaStack All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Checks that the CBOR and MessagePack output of each test decodes to the same value as its
+# JSON output.
+
+source "tests.source"
+
+for TEST in *.jsonlang ; do
+
+    if [ $(echo "$TEST" | cut -b 1-6) == "error." ] || [[ "$TEST" =~ ^tla[.] ]] ; then
+        continue
+    fi
+
+    EXT_PARAMS="--ext-str var1=test --ext-code var2={x:1,y:2}"
+    JSON="$(../jsonlang $EXT_PARAMS "$TEST" 2>/dev/null | ./binary_to_json.py json 2>/dev/null)"
+    if [ -z "$JSON" ] ; then
+        continue  # Not JSON, e.g. a string.
+    fi
+
+    for FORMAT in cbor msgpack ; do
+        EXECUTED=$((EXECUTED + 1))
+        TEST_OUTPUT="$(../jsonlang $EXT_PARAMS --output-format $FORMAT "$TEST" 2>/dev/null \
+                       | ./binary_to_json.py $FORMAT 2>&1)"
+        if [ "$TEST_OUTPUT" != "$JSON" ] ; then
+            FAILED=$((FAILED + 1))
+            echo -e "\e[31;1mFAIL\e[0m \e[1m($FORMAT mismatch)\e[0m: \e[36m$TEST\e[0m"
+            echo "This run's output:"
+            echo "$TEST_OUTPUT"
+            echo "Expected:"
+            echo "$JSON"
+        elif $VERBOSE ; then
+            echo -e "\e[32mSUCCESS\e[0m: \e[36m$TEST\e[0m ($FORMAT)"
+        fi
+    done
+done
+
+if [ $FAILED -eq 0 ] ; then
+    echo "All $EXECUTED test scripts pass."
+else
+    echo "FAILED: $FAILED / $EXECUTED"
+    exit 1
+fi
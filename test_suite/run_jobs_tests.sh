@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Copyright 2016 LambdaStack All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Checks that multi mode (-m) with --jobs gives the same files, output and errors as without.
+
+source "tests.source"
+
+OUT_DIR="$(mktemp -d)"
+trap 'rm -rf "$OUT_DIR"' EXIT
+
+# Runs -m into OUT_DIR with the given extra parameters, and prints the exit code, the output and
+# the files that were written.
+run_multi() {
+    rm -rf "$OUT_DIR"/*
+    ../jsonlang $EXT_PARAMS -m "$OUT_DIR/" "$@" "$TEST" 2>&1 | sed "s|$OUT_DIR/|OUT/|g"
+    echo "exit code: ${PIPESTATUS[0]}"
+    (cd "$OUT_DIR" && find . -type f ! -name .jsonlang-multi | sort | while read -r FILE ; do
+        echo "file: $FILE"
+        cat "$FILE"
+    done)
+}
+
+for TEST in *.jsonlang ; do
+
+    if [[ "$TEST" =~ ^tla[.] ]] ; then
+        continue
+    fi
+
+    EXT_PARAMS="--ext-str var1=test --ext-code var2={x:1,y:2}"
+    EXPECTED="$(run_multi)"
+    EXECUTED=$((EXECUTED + 1))
+    TEST_OUTPUT="$(run_multi -j 2)"
+    if [ "$TEST_OUTPUT" != "$EXPECTED" ] ; then
+        FAILED=$((FAILED + 1))
+        echo -e "\e[31;1mFAIL\e[0m \e[1m(-j 2 mismatch)\e[0m: \e[36m$TEST\e[0m"
+        echo "This run's output:"
+        echo "$TEST_OUTPUT"
+        echo "Expected:"
+        echo "$EXPECTED"
+    elif $VERBOSE ; then
+        echo -e "\e[32mSUCCESS\e[0m: \e[36m$TEST\e[0m"
+    fi
+done
+
+if [ $FAILED -eq 0 ] ; then
+    echo "All $EXECUTED test scripts pass."
+else
+    echo "FAILED: $FAILED / $EXECUTED"
+    exit 1
+fi